@@ -0,0 +1,154 @@
+#include "AssetLoader.hpp"
+#include "read_chunk.hpp"
+#include "timeline.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_set>
+#include <unordered_map>
+#include <chrono>
+
+void SceneBlob::load(std::string const &filename) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Failed to open scene file '" + filename + "'");
+	}
+
+	bool trailing = false;
+	std::vector< ChunkInfo > toc = index_chunks(file, &trailing);
+	if (trailing) {
+		std::cerr << "WARNING: trailing data in scene file '" + filename + "'" << std::endl;
+	}
+	ChunkInfo const *strings_chunk = find_chunk(toc, "str0");
+	ChunkInfo const *scene_chunk = find_chunk(toc, "scn0");
+	if (!strings_chunk || !scene_chunk) {
+		throw std::runtime_error("scene file is missing a str0 or scn0 chunk");
+	}
+
+	read_chunk(file, *strings_chunk, &strings);
+	read_chunk(file, *scene_chunk, &entries);
+	for (auto const &entry : entries) {
+		if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
+			throw std::runtime_error("index entry has out-of-range name begin/end");
+		}
+	}
+
+	tags.clear();
+	if (ChunkInfo const *tags_chunk = find_chunk(toc, "tag0")) {
+		read_chunk(file, *tags_chunk, &tags);
+		if (tags.size() != entries.size()) {
+			throw std::runtime_error("tag0 chunk size doesn't match scn0 chunk size");
+		}
+	}
+}
+
+AssetLoader::AssetLoader(std::string const &scene_filename_, std::string const &meshes_filename_)
+	: scene_filename(scene_filename_), meshes_filename(meshes_filename_), scenes(1), meshes(64) {
+	thread = std::thread(&AssetLoader::run, this);
+}
+
+AssetLoader::~AssetLoader() {
+	quit.store(true);
+	thread.join();
+}
+
+void AssetLoader::check_error() {
+	if (finished.load(std::memory_order_acquire) && error) {
+		std::exception_ptr rethrow = error;
+		error = nullptr; //(only report once)
+		std::rethrow_exception(rethrow);
+	}
+}
+
+bool AssetLoader::pop_scene(SceneBlob *scene) {
+	if (scenes.pop(scene)) return true;
+	check_error();
+	return false;
+}
+
+bool AssetLoader::pop_mesh(StagedMesh *mesh) {
+	if (meshes.pop(mesh)) return true;
+	check_error();
+	return false;
+}
+
+bool AssetLoader::done() const {
+	return finished.load(std::memory_order_acquire) && scenes.empty() && meshes.empty();
+}
+
+//push to a queue, waiting for the GL thread to make room; returns false if asked to quit:
+template< typename T >
+static bool push_or_quit(SPSCQueue< T > &queue, T &&item, std::atomic< bool > const &quit) {
+	while (!queue.push(std::move(item))) {
+		if (quit.load()) return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+void AssetLoader::run() {
+	timeline_mark("loader thread started");
+	try {
+		SceneBlob scene;
+		scene.load(scene_filename);
+		timeline_mark("read '" + scene_filename + "' (" + std::to_string(scene.entries.size()) + " entries)");
+
+		//meshes get read in the order the scene first uses them:
+		std::vector< MeshID > used;
+		{
+			std::unordered_set< MeshID > seen;
+			for (auto const &entry : scene.entries) {
+				MeshID id = mesh_id(scene.strings.data() + entry.name_begin, scene.strings.data() + entry.name_end);
+				if (seen.insert(id).second) used.emplace_back(id);
+			}
+		}
+
+		if (push_or_quit(scenes, std::move(scene), quit)) {
+			std::ifstream file(meshes_filename, std::ios::binary);
+			if (!file) {
+				throw std::runtime_error("Failed to open mesh file '" + meshes_filename + "'");
+			}
+			Meshes::FileIndex index;
+			Meshes::read_index(file, meshes_filename, &index);
+			if (index.trailing) {
+				std::cerr << "WARNING: trailing data in mesh file '" + meshes_filename + "'" << std::endl;
+			}
+			timeline_mark("read '" + meshes_filename + "' index (" + std::to_string(index.entries.size()) + " meshes)");
+
+			std::unordered_map< MeshID, uint32_t > entries;
+			for (uint32_t i = 0; i < index.entries.size(); ++i) {
+				entries.insert(std::make_pair(index.entries[i].id, i)); //(first entry wins, like Meshes::load)
+			}
+
+			//entries that share vertices (see FileEntry::same_as) are read once, by whichever is used
+			// first; the rest are sent as aliases of that one:
+			std::unordered_map< uint32_t, MeshID > read_as; //first entry with those vertices -> id they were sent as
+			uint32_t aliases = 0;
+
+			for (MeshID id : used) {
+				if (quit.load()) break;
+				auto f = entries.find(id);
+				if (f == entries.end()) continue; //(reported by the GL thread when nothing arrives for it)
+				Meshes::FileEntry const &entry = index.entries[f->second];
+				uint32_t first = (entry.same_as == -1U ? f->second : entry.same_as);
+				StagedMesh staged;
+				auto r = read_as.find(first);
+				if (r != read_as.end()) {
+					staged.id = entry.id;
+					staged.name = entry.name;
+					staged.alias = r->second;
+					aliases += 1;
+				} else {
+					Meshes::read_staged(file, index, entry, &staged);
+					read_as.insert(std::make_pair(first, entry.id));
+				}
+				if (!push_or_quit(meshes, std::move(staged), quit)) break;
+			}
+			timeline_mark("read vertices of " + std::to_string(used.size() - aliases) + " meshes used by scene (" + std::to_string(aliases) + " more share them)");
+		}
+	} catch (...) {
+		error = std::current_exception();
+	}
+	finished.store(true, std::memory_order_release);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Meshes.hpp"
+#include "spsc_queue.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <exception>
+
+//contents of a scene blob (read and validated, but not yet turned into Scene::Objects):
+struct SceneBlob {
+	struct Entry {
+		uint32_t name_begin, name_end;
+		glm::vec3 position;
+		glm::quat rotation;
+		glm::vec3 scale;
+	};
+	static_assert(sizeof(Entry) == 48, "Scene entry should be packed");
+
+	//per-entry gameplay info (parallel to scn0; see 'tag0' in export-pool-meshes.py):
+	struct Tag {
+		uint32_t type;
+		float radius; //collision radius
+		uint32_t flags;
+	};
+	static_assert(sizeof(Tag) == 12, "Scene tag should be packed");
+
+	std::vector< char > strings;
+	std::vector< Entry > entries;
+	std::vector< Tag > tags; //empty if the file had no tag0 chunk
+
+	//read a scene blob:
+	// note: will throw if the file fails to read or is inconsistent.
+	void load(std::string const &filename);
+};
+
+//"AssetLoader" reads a scene and the meshes it uses on a background thread,
+// so the GL thread can start drawing frames right away:
+// - the scene blob is read first and handed over (once) through pop_scene();
+// - then each mesh the scene uses is read from the mesh blob (in scene order)
+//   and handed over through pop_mesh(), for the GL thread to upload with
+//   Meshes::add_staged() at whatever pace it likes;
+// - meshes that share their vertices in the file (e.g., every pool ball) are read
+//   once, and the rest are handed over as aliases of it (see StagedMesh::alias).
+struct AssetLoader {
+	AssetLoader(std::string const &scene_filename, std::string const &meshes_filename);
+	~AssetLoader(); //stops (and joins) the loader thread
+	AssetLoader(AssetLoader const &) = delete;
+	AssetLoader &operator=(AssetLoader const &) = delete;
+
+	//GL thread: take the scene, if it has been read; returns false otherwise:
+	// note: rethrows any error from the loader thread.
+	bool pop_scene(SceneBlob *scene);
+	//GL thread: take the next mesh, if one has been read; returns false otherwise:
+	// note: rethrows any error from the loader thread.
+	bool pop_mesh(StagedMesh *mesh);
+	//true once everything has been read and popped:
+	bool done() const;
+
+	//internals:
+	std::string scene_filename;
+	std::string meshes_filename;
+	SPSCQueue< SceneBlob > scenes;
+	SPSCQueue< StagedMesh > meshes; //bounded, so the loader can't run too far ahead of uploads
+	std::atomic< bool > finished{false}; //loader thread has pushed everything (or failed)
+	std::atomic< bool > quit{false}; //set by destructor to stop loader early
+	std::exception_ptr error; //written by loader thread before 'finished' is set
+	std::thread thread;
+
+	void run(); //(loader thread)
+	void check_error(); //rethrow 'error', if set and finished
+};
@@ -0,0 +1,142 @@
+#include "DebugOutput.hpp"
+
+#include <iostream>
+#include <cstring>
+
+static DebugOutput::Type type_index(GLenum type) {
+	switch (type) {
+		case GL_DEBUG_TYPE_ERROR: return DebugOutput::Error;
+		case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return DebugOutput::Deprecated;
+		case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return DebugOutput::Undefined;
+		case GL_DEBUG_TYPE_PORTABILITY: return DebugOutput::Portability;
+		case GL_DEBUG_TYPE_PERFORMANCE: return DebugOutput::Performance;
+		default: return DebugOutput::Other;
+	}
+}
+
+static char const *source_name(GLenum source) {
+	switch (source) {
+		case GL_DEBUG_SOURCE_API: return "api";
+		case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+		case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+		case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+		case GL_DEBUG_SOURCE_APPLICATION: return "application";
+		default: return "other";
+	}
+}
+
+static char const *severity_name(GLenum severity) {
+	switch (severity) {
+		case GL_DEBUG_SEVERITY_HIGH: return "high";
+		case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+		case GL_DEBUG_SEVERITY_LOW: return "low";
+		default: return "notification";
+	}
+}
+
+char const *DebugOutput::type_name(uint32_t type) {
+	static char const *names[TypeCount] = {"error", "deprecated", "undefined behavior", "portability", "performance", "other"};
+	return (type < TypeCount ? names[type] : "?");
+}
+
+DebugOutput::Counts &DebugOutput::Counts::operator+=(Counts const &other) {
+	for (uint32_t t = 0; t < TypeCount; ++t) {
+		by_type[t] += other.by_type[t];
+	}
+	return *this;
+}
+
+static void APIENTRY debug_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, GLchar const *message, void const *user) {
+	DebugOutput *output = const_cast< DebugOutput * >(reinterpret_cast< DebugOutput const * >(user));
+	output->message(source, type, id, severity, (length < 0 ? std::string(message) : std::string(message, length)));
+}
+
+DebugOutput::DebugOutput(void *(*get_proc_address)(char const *)) {
+	//debug output is core in 4.3, and otherwise comes from an extension:
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	bool khr_debug = (major > 4 || (major == 4 && minor >= 3));
+	bool arb_debug_output = false;
+	//(glGetStringi isn't in gl_shims, so it's looked up too)
+	PFNGLGETSTRINGIPROC GetStringi = (PFNGLGETSTRINGIPROC)get_proc_address("glGetStringi");
+	if (!khr_debug && GetStringi) {
+		GLint extensions = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+		for (GLint i = 0; i < extensions; ++i) {
+			char const *name = reinterpret_cast< char const * >(GetStringi(GL_EXTENSIONS, i));
+			if (!name) continue;
+			if (std::strcmp(name, "GL_KHR_debug") == 0) khr_debug = true;
+			if (std::strcmp(name, "GL_ARB_debug_output") == 0) arb_debug_output = true;
+		}
+	}
+	PFNGLDEBUGMESSAGECONTROLPROC DebugMessageControl = nullptr;
+	if (khr_debug) {
+		DebugMessageCallback = (PFNGLDEBUGMESSAGECALLBACKPROC)get_proc_address("glDebugMessageCallback");
+		DebugMessageControl = (PFNGLDEBUGMESSAGECONTROLPROC)get_proc_address("glDebugMessageControl");
+	} else if (arb_debug_output) { //(same signatures, with ARB names)
+		DebugMessageCallback = (PFNGLDEBUGMESSAGECALLBACKPROC)get_proc_address("glDebugMessageCallbackARB");
+		DebugMessageControl = (PFNGLDEBUGMESSAGECONTROLPROC)get_proc_address("glDebugMessageControlARB");
+	}
+	if (!DebugMessageCallback || !DebugMessageControl) {
+		DebugMessageCallback = nullptr;
+		std::cerr << "NOTE: OpenGL debug output isn't supported; driver warnings won't be reported." << std::endl;
+		return;
+	}
+
+	//(drivers may only send messages -- performance ones especially -- to debug contexts)
+	GLint flags = 0;
+	glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+	if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT)) {
+		std::cerr << "NOTE: not a debug context; the driver may not report much through debug output." << std::endl;
+	}
+
+	DebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+	glEnable(GL_DEBUG_OUTPUT); //(already on in debug contexts)
+	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS); //(so messages arrive on this thread, during the call that caused them)
+	DebugMessageCallback(debug_callback, this);
+	active = true;
+}
+
+DebugOutput::~DebugOutput() {
+	if (!active) return;
+	DebugMessageCallback(nullptr, nullptr);
+	total += frame;
+	uint32_t messages = 0;
+	for (uint32_t t = 0; t < TypeCount; ++t) {
+		messages += total.by_type[t];
+	}
+	if (messages) {
+		std::cout << "OpenGL debug output: " << messages << " messages (" << seen.size() << " distinct):";
+		for (uint32_t t = 0; t < TypeCount; ++t) {
+			if (total.by_type[t]) std::cout << " " << total.by_type[t] << " " << type_name(t) << ";";
+		}
+		std::cout << std::endl;
+	}
+}
+
+DebugOutput::Counts DebugOutput::end_frame() {
+	Counts ret = frame;
+	total += frame;
+	frame = Counts();
+	return ret;
+}
+
+void DebugOutput::message(GLenum source, GLenum type, GLuint id, GLenum severity, std::string const &text) {
+	Type index = type_index(type);
+	frame.by_type[index] += 1;
+
+	//print each distinct message once:
+	std::string key = std::to_string(source) + " " + std::to_string(type) + " " + std::to_string(id) + " " + text;
+	auto found = seen.find(key);
+	if (found != seen.end()) {
+		found->second += 1;
+		return;
+	}
+	if (seen.size() >= MaxDistinct) return; //(still counted above, just not printed)
+	seen.emplace(key, 1);
+	if (severity == GL_DEBUG_SEVERITY_NOTIFICATION) return;
+	std::cerr << (index == Error ? "WARNING" : "NOTE") << ": OpenGL " << type_name(index) << " (" << source_name(source) << ", " << severity_name(severity) << ", id " << id << "): " << text;
+	if (text.empty() || text.back() != '\n') std::cerr << std::endl;
+	else std::cerr.flush();
+}
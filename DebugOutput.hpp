@@ -0,0 +1,55 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+
+//"DebugOutput" listens to the driver's debug messages (GL 4.3, KHR_debug, or ARB_debug_output),
+// which -- in the debug contexts main.cpp asks for -- include performance warnings (shader
+// recompiles, implicit syncs, slow paths) that are otherwise silently lost:
+// - messages are delivered synchronously, on the GL thread, during the call that caused them;
+// - each distinct message is printed once (notifications aren't printed at all), but every
+//   one is counted, by type, both per frame (see end_frame()) and over the whole run;
+// - the destructor prints a summary of the run.
+// (messages from other contexts -- e.g., GLUploader's -- don't come here)
+struct DebugOutput {
+	//install the callback on the current context, if it supports debug output and is a debug context:
+	// 'get_proc_address' looks up GL functions (e.g., SDL_GL_GetProcAddress, or HeadlessGL::get_proc_address)
+	DebugOutput(void *(*get_proc_address)(char const *));
+	~DebugOutput(); //(removes the callback; the context must still be current)
+	DebugOutput(DebugOutput const &) = delete;
+	DebugOutput &operator=(DebugOutput const &) = delete;
+
+	bool active = false; //the callback is installed
+
+	//message types (GL_DEBUG_TYPE_*):
+	enum Type {
+		Error,
+		Deprecated,
+		Undefined,
+		Portability,
+		Performance,
+		Other, //(including markers and groups)
+		TypeCount
+	};
+	static char const *type_name(uint32_t type);
+	struct Counts {
+		uint32_t by_type[TypeCount] = {0, 0, 0, 0, 0, 0};
+		//(messages that mean something is wrong or slow, as opposed to informational ones)
+		uint32_t problems() const { return by_type[Error] + by_type[Undefined] + by_type[Performance]; }
+		Counts &operator+=(Counts const &other);
+	};
+
+	//call once a frame: returns the counts since the last call, and starts counting again:
+	Counts end_frame();
+	Counts frame; //(since the last end_frame())
+	Counts total; //(since the callback was installed)
+
+	//internals:
+	enum { MaxDistinct = 1000 }; //(messages that vary every time -- say, with an address in them -- shouldn't grow 'seen' forever)
+	std::unordered_map< std::string, uint32_t > seen; //times each distinct message (keyed by source, type, id, and text) arrived
+	void message(GLenum source, GLenum type, GLuint id, GLenum severity, std::string const &text);
+	PFNGLDEBUGMESSAGECALLBACKPROC DebugMessageCallback = nullptr;
+};
@@ -0,0 +1,286 @@
+#include "FrameCapture.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <chrono>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <cassert>
+
+#ifdef __linux__
+#include <fcntl.h>
+#endif
+
+//seek within a (possibly >2GB) file:
+static bool seek(FILE *file, int64_t offset) {
+#ifdef _WIN32
+	return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, off_t(offset), SEEK_SET) == 0;
+#endif
+}
+
+FrameCapture::FrameCapture(glm::uvec2 size_, uint32_t buffers, uint32_t encoder_count) : size(size_), slots(buffers) {
+	assert(buffers > 0);
+	assert(encoder_count > 0);
+	screenshot_png.threads = std::max(1U, std::thread::hardware_concurrency());
+	sequence_png.level = 1;
+	sequence_png.filter = PNGEncodeOptions::UpFilter;
+	for (auto &slot : slots) {
+		glGenBuffers(1, &slot.buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, size.x * size.y * sizeof(uint32_t), nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	//(every queue has room for every slot, so pushes never fail)
+	for (uint32_t i = 0; i < encoder_count; ++i) {
+		encoders.emplace_back(new Encoder(buffers));
+	}
+	for (auto &encoder : encoders) {
+		encoder->thread = std::thread(&FrameCapture::encode, this, encoder.get());
+	}
+}
+
+FrameCapture::~FrameCapture() {
+	stop();
+}
+
+void FrameCapture::stop() {
+	if (encoders.empty()) return;
+	if (sequence.active) end_sequence();
+	finish();
+	quit.store(true);
+	for (auto &encoder : encoders) {
+		encoder->thread.join();
+	}
+	encoders.clear();
+	for (auto &slot : slots) {
+		glDeleteBuffers(1, &slot.buffer);
+		slot.buffer = 0;
+	}
+}
+
+void FrameCapture::start_capture(Slot &slot) {
+	assert(slot.state == Slot::Free);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, (GLbyte *)0); //(into the buffer, so doesn't wait)
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.state = Slot::Reading;
+}
+
+uint32_t FrameCapture::busy() const {
+	uint32_t count = 0;
+	for (auto const &slot : slots) {
+		if (slot.state != Slot::Free) count += 1;
+	}
+	return count;
+}
+
+bool FrameCapture::capture(std::string const &filename) {
+	Slot &slot = slots[next];
+	if (slot.state != Slot::Free) return false;
+	next = (next + 1) % slots.size();
+
+	slot.filename = filename;
+	slot.png = &screenshot_png;
+	slot.raw_offset = -1;
+	start_capture(slot);
+	return true;
+}
+
+void FrameCapture::update() {
+	//buffers the encoders are done with can be unmapped and reused:
+	for (auto &encoder : encoders) {
+		uint32_t index;
+		while (encoder->written.pop(&index)) {
+			Slot &slot = slots[index];
+			assert(slot.state == Slot::Encoding);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			slot.state = Slot::Free;
+			encoder->outstanding -= 1;
+		}
+	}
+
+	//finished readbacks get mapped and sent to the least-busy encoder:
+	for (uint32_t i = 0; i < slots.size(); ++i) {
+		Slot &slot = slots[i];
+		if (slot.state != Slot::Reading) continue;
+		GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0); //(zero timeout: just poll)
+		if (status == GL_TIMEOUT_EXPIRED) continue;
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+		void const *pixels = nullptr;
+		if (status != GL_WAIT_FAILED) {
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+			pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size.x * size.y * sizeof(uint32_t), GL_MAP_READ_BIT);
+		}
+		if (!pixels) {
+			std::cerr << "WARNING: failed to read back a captured frame; not saving it." << std::endl;
+			slot.state = Slot::Free;
+			continue;
+		}
+		Encoder *encoder = encoders[0].get();
+		for (auto &e : encoders) {
+			if (e->outstanding < encoder->outstanding) encoder = e.get();
+		}
+		Frame frame;
+		frame.slot = i;
+		frame.pixels = pixels;
+		frame.filename = slot.filename;
+		frame.png = slot.png;
+		frame.raw_offset = slot.raw_offset;
+		bool pushed = encoder->to_write.push(std::move(frame));
+		assert(pushed && "to_write has room for every slot");
+		(void)pushed;
+		encoder->outstanding += 1;
+		slot.state = Slot::Encoding;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void FrameCapture::finish() {
+	while (true) {
+		update();
+		if (busy() == 0) break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+void FrameCapture::start_sequence(std::string const &path, SequenceFormat format, uint32_t max_frames) {
+	if (sequence.active) end_sequence();
+
+	if (format == RawSequence) {
+		raw_file = fopen(path.c_str(), "wb");
+		if (!raw_file) {
+			throw std::runtime_error("Failed to create raw capture file '" + path + "'.");
+		}
+		RawHeader header;
+		std::memcpy(header.magic, "rawf", 4);
+		header.width = size.x;
+		header.height = size.y;
+		header.frames = 0;
+		header.max_frames = max_frames;
+		int64_t total = int64_t(sizeof(RawHeader)) + int64_t(max_frames) * size.x * size.y * sizeof(uint32_t);
+		bool ok = (fwrite(&header, sizeof(header), 1, raw_file) == 1);
+		//allocate the whole file now, so the filesystem doesn't have to while frames are being written:
+#ifdef __linux__
+		ok = ok && (fflush(raw_file) == 0) && (posix_fallocate(fileno(raw_file), 0, off_t(total)) == 0);
+#else
+		ok = ok && seek(raw_file, total - 1) && (fputc(0, raw_file) != EOF);
+#endif
+		if (!ok) {
+			fclose(raw_file);
+			raw_file = nullptr;
+			throw std::runtime_error("Failed to allocate " + std::to_string(total >> 20) + "MB for raw capture file '" + path + "'.");
+		}
+	}
+
+	sequence.active = true;
+	sequence.format = format;
+	sequence.path = path;
+	sequence.max_frames = max_frames;
+	sequence.stats = SequenceStats();
+	sequence.warned = false;
+	sequence.busy_us_before = 0;
+	for (auto const &encoder : encoders) {
+		sequence.busy_us_before += encoder->busy_us.load();
+	}
+}
+
+bool FrameCapture::capture_sequence() {
+	assert(sequence.active);
+	SequenceStats &stats = sequence.stats;
+	if (stats.frames >= sequence.max_frames) return false;
+
+	//back-pressure: if the encoders have fallen behind, the only way to not drop a frame is to wait:
+	if (slots[next].state != Slot::Free) update(); //(maybe it's written already, just not reclaimed)
+	if (slots[next].state != Slot::Free) {
+		if (!sequence.warned) {
+			std::cerr << "WARNING: frame capture is falling behind (all " << slots.size() << " buffers busy); the render loop is waiting for it." << std::endl;
+			sequence.warned = true;
+		}
+		auto before = std::chrono::high_resolution_clock::now();
+		while (true) {
+			update();
+			if (slots[next].state == Slot::Free) break;
+			std::this_thread::sleep_for(std::chrono::microseconds(250));
+		}
+		stats.waits += 1;
+		stats.wait_ms += std::chrono::duration< float, std::milli >(std::chrono::high_resolution_clock::now() - before).count();
+	}
+
+	Slot &slot = slots[next];
+	next = (next + 1) % slots.size();
+	if (sequence.format == RawSequence) {
+		slot.filename.clear();
+		slot.png = nullptr;
+		slot.raw_offset = int64_t(sizeof(RawHeader)) + int64_t(stats.frames) * size.x * size.y * sizeof(uint32_t);
+	} else {
+		char index[16];
+		snprintf(index, sizeof(index), "-%05u.png", stats.frames);
+		slot.filename = sequence.path + index;
+		slot.png = &sequence_png;
+		slot.raw_offset = -1;
+	}
+	start_capture(slot);
+	stats.frames += 1;
+	stats.max_busy = std::max(stats.max_busy, busy());
+	return true;
+}
+
+void FrameCapture::end_sequence() {
+	if (!sequence.active) return;
+	finish();
+	SequenceStats &stats = sequence.stats;
+	uint64_t busy_us = 0;
+	for (auto const &encoder : encoders) {
+		busy_us += encoder->busy_us.load();
+	}
+	busy_us -= sequence.busy_us_before; //(includes any screenshots taken meanwhile, but those are rare)
+	if (busy_us) {
+		stats.encode_mb_per_s = float(double(stats.frames) * size.x * size.y * sizeof(uint32_t) / double(busy_us));
+	}
+	if (raw_file) {
+		//record how many frames are actually there:
+		bool ok = seek(raw_file, offsetof(RawHeader, frames)) && (fwrite(&stats.frames, sizeof(stats.frames), 1, raw_file) == 1);
+		if (fclose(raw_file) != 0 || !ok) {
+			std::cerr << "WARNING: failed to finish writing '" << sequence.path << "'." << std::endl;
+		}
+		raw_file = nullptr;
+	}
+	std::cout << "Captured " << stats.frames << " frames to '" << sequence.path << "'";
+	if (stats.waits) {
+		std::cout << "; waited for encoders on " << stats.waits << " frames (" << stats.wait_ms << "ms in all), so capture was slowing the game down -- try more encoder threads or raw capture";
+	}
+	std::cout << " (at most " << stats.max_busy << " of " << slots.size() << " buffers in use; " << stats.encode_mb_per_s << " MB/s per encoder)." << std::endl;
+	sequence.active = false;
+}
+
+void FrameCapture::encode(Encoder *encoder) {
+	Frame frame;
+	while (!quit.load()) {
+		if (!encoder->to_write.pop(&frame)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		auto before = std::chrono::high_resolution_clock::now();
+		size_t bytes = size.x * size.y * sizeof(uint32_t);
+		if (frame.raw_offset >= 0) {
+			std::lock_guard< std::mutex > lock(raw_mutex);
+			if (!seek(raw_file, frame.raw_offset) || fwrite(frame.pixels, bytes, 1, raw_file) != 1) {
+				std::cerr << "WARNING: failed to write frame to raw capture file." << std::endl;
+			}
+		} else {
+			//(glReadPixels rows start at the bottom of the frame)
+			save_png(frame.filename, size.x, size.y, reinterpret_cast< uint32_t const * >(frame.pixels), LowerLeftOrigin, *frame.png);
+		}
+		encoder->busy_us += std::chrono::duration_cast< std::chrono::microseconds >(std::chrono::high_resolution_clock::now() - before).count();
+		bool pushed = encoder->written.push(std::move(frame.slot));
+		assert(pushed && "written has room for every slot");
+		(void)pushed;
+	}
+}
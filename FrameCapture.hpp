@@ -0,0 +1,134 @@
+#pragma once
+
+#include "GL.hpp"
+#include "spsc_queue.hpp"
+#include "load_save_png.hpp"
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cstdio>
+
+//"FrameCapture" saves rendered frames without stalling the render loop:
+// - capture() starts copying the current read framebuffer into one of a ring of
+//   pixel-pack buffers (glReadPixels into a buffer returns right away) and fences it;
+// - update(), called once a frame, maps buffers whose fences have signaled and hands
+//   them (still mapped) to the least-busy of several encoder threads, which write them
+//   right out of the mapping (save_png, or a plain copy for raw sequences);
+// - once written, update() unmaps the buffer and it can be captured into again.
+// So the ring is a bounded queue of captured frames: single screenshots are skipped
+// if it's full, while sequences wait for room (and report it, see SequenceStats).
+struct FrameCapture {
+	//'size' is the framebuffer size; each of 'buffers' holds one frame; 'encoders' write frames in parallel:
+	FrameCapture(glm::uvec2 size, uint32_t buffers = 3, uint32_t encoders = 1);
+	~FrameCapture(); //calls stop()
+	//finish pending frames, stop the encoder threads, and delete the buffers; call before the context goes away:
+	void stop();
+	FrameCapture(FrameCapture const &) = delete;
+	FrameCapture &operator=(FrameCapture const &) = delete;
+
+	//GL thread: start reading back the frame just drawn, to be saved as 'filename':
+	// returns false (capturing nothing) if every buffer is still busy with earlier frames.
+	bool capture(std::string const &filename);
+	//GL thread: move captures along (never waits):
+	void update();
+	//GL thread: wait until every capture so far has been written:
+	void finish();
+
+	//frame sequences (e.g., for replay videos), where every frame counts:
+	enum SequenceFormat {
+		PNGSequence, //'path'-00000.png, 'path'-00001.png, ...
+		RawSequence, //one file, 'path', preallocated for 'max_frames' uncompressed frames (see RawHeader)
+	};
+	//GL thread: start a sequence of up to 'max_frames' frames:
+	// note: throws if a raw file can't be created.
+	void start_sequence(std::string const &path, SequenceFormat format, uint32_t max_frames);
+	//GL thread: capture the frame just drawn into the sequence; if every buffer is busy, waits for one:
+	// returns false once the sequence has 'max_frames' frames (the frame isn't captured).
+	bool capture_sequence();
+	//GL thread: wait for the sequence's frames to be written, close it, and print SequenceStats:
+	void end_sequence();
+	bool recording() const { return sequence.active; }
+
+	//how PNGs get compressed: screenshots come one at a time, so they keep the default
+	// (small) compression and split it across threads; sequence frames are already spread
+	// over the encoder threads, so each is compressed quickly on one (see the constructor):
+	PNGEncodeOptions screenshot_png;
+	PNGEncodeOptions sequence_png;
+
+	//raw sequence files are a RawHeader followed by room for 'max_frames' frames, of which the
+	// first 'frames' were captured; each frame is width*height RGBA8 pixels, bottom row first
+	// (as from glReadPixels). (Not chunks as in read_chunk.hpp: a minute of frames passes 4GB.)
+	struct RawHeader {
+		char magic[4]; //"rawf"
+		uint32_t width, height;
+		uint32_t frames;
+		uint32_t max_frames;
+	};
+	static_assert(sizeof(RawHeader) == 20, "RawHeader is packed");
+
+	//how well the encoders kept up with a sequence:
+	struct SequenceStats {
+		uint32_t frames = 0;
+		uint32_t waits = 0; //frames that had to wait for a free buffer
+		float wait_ms = 0.0f; //total time the render thread spent waiting
+		uint32_t max_busy = 0; //most buffers in use at once
+		float encode_mb_per_s = 0.0f; //frame data written per second of encoder-thread time
+	};
+
+	//internals:
+	struct Slot {
+		enum State {
+			Free,
+			Reading, //glReadPixels issued; waiting on 'fence'
+			Encoding, //mapped; owned by an encoder thread until it shows up in that encoder's 'written'
+		} state = Free;
+		GLuint buffer = 0;
+		GLsync fence = 0;
+		std::string filename; //(empty for raw frames)
+		PNGEncodeOptions const *png = nullptr; //(PNG frames only)
+		int64_t raw_offset = -1; //where in the raw sequence file the frame goes (raw frames only)
+	};
+	//what an encoder gets:
+	struct Frame {
+		uint32_t slot = 0;
+		void const *pixels = nullptr;
+		std::string filename;
+		PNGEncodeOptions const *png = nullptr;
+		int64_t raw_offset = -1;
+	};
+	struct Encoder {
+		Encoder(uint32_t capacity) : to_write(capacity), written(capacity) { }
+		SPSCQueue< Frame > to_write; //GL thread -> encoder
+		SPSCQueue< uint32_t > written; //encoder -> GL thread (slot indices)
+		uint32_t outstanding = 0; //(GL thread only) frames pushed, not yet popped from 'written'
+		std::atomic< uint64_t > busy_us{0}; //time spent writing frames, in microseconds
+		std::thread thread;
+	};
+	glm::uvec2 size;
+	std::vector< Slot > slots;
+	uint32_t next = 0; //(slots are used in order)
+	std::vector< std::unique_ptr< Encoder > > encoders;
+
+	struct {
+		bool active = false;
+		SequenceFormat format = PNGSequence;
+		std::string path;
+		uint32_t max_frames = 0;
+		SequenceStats stats;
+		bool warned = false; //(about falling behind)
+		uint64_t busy_us_before = 0; //(encoders' busy_us at the start of the sequence)
+	} sequence;
+	FILE *raw_file = nullptr; //open while a raw sequence is recording
+	std::mutex raw_mutex; //encoders seek + write 'raw_file' one at a time
+
+	std::atomic< bool > quit{false};
+
+	void start_capture(Slot &slot); //(GL thread) issue the readback into 'slot' (which must be Free)
+	uint32_t busy() const; //(GL thread) slots not Free
+	void encode(Encoder *encoder); //(encoder thread)
+};
@@ -0,0 +1,223 @@
+#include "FrameTimers.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+
+void FrameTimers::Rolling::push(float value, uint32_t window) {
+	if (values.size() < window) {
+		values.emplace_back(value);
+	} else {
+		values[next] = value;
+	}
+	next = (next + 1) % window;
+}
+
+float FrameTimers::Rolling::average() const {
+	if (values.empty()) return 0.0f;
+	float sum = 0.0f;
+	for (float v : values) sum += v;
+	return sum / values.size();
+}
+
+float FrameTimers::Rolling::max() const {
+	float ret = 0.0f;
+	for (float v : values) ret = std::max(ret, v);
+	return ret;
+}
+
+FrameTimers::FrameTimers(uint32_t ring, uint32_t window_) : window(std::max(1U, window_)) {
+	//(GL_TIMESTAMP is core in 3.3, but may have no bits, i.e., not work)
+	GLint bits = 0;
+	glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+	gpu = (bits > 0);
+	if (!gpu) {
+		std::cerr << "NOTE: GL_TIMESTAMP queries aren't supported; only CPU time will be measured." << std::endl;
+	}
+	slots.resize(std::max(1U, ring));
+}
+
+FrameTimers::~FrameTimers() {
+	for (auto &slot : slots) {
+		if (!slot.queries.empty()) glDeleteQueries(slot.queries.size(), slot.queries.data());
+	}
+}
+
+uint32_t FrameTimers::timer_index(char const *name) {
+	for (uint32_t i = 0; i < timers.size(); ++i) {
+		if (std::strcmp(timers[i].name.c_str(), name) == 0) return i;
+	}
+	timers.emplace_back();
+	timers.back().name = name;
+	timers.back().depth = open.size();
+	return timers.size() - 1;
+}
+
+GLuint FrameTimers::next_query(Slot &slot) {
+	if (slot.used == slot.queries.size()) {
+		GLuint query = 0;
+		glGenQueries(1, &query);
+		slot.queries.emplace_back(query);
+	}
+	return slot.used++;
+}
+
+bool FrameTimers::collect(Slot &slot, bool wait) {
+	assert(slot.pending);
+	if (!wait) {
+		//(results arrive in order, but checking each is cheap and doesn't rely on that)
+		for (uint32_t q = 0; q < slot.used; ++q) {
+			GLint available = 0;
+			glGetQueryObjectiv(slot.queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) return false;
+		}
+	}
+	std::vector< GLuint64 > stamps(slot.used);
+	for (uint32_t q = 0; q < slot.used; ++q) {
+		glGetQueryObjectui64v(slot.queries[q], GL_QUERY_RESULT, &stamps[q]); //(ready, unless 'wait')
+	}
+	std::vector< double > ms(timers.size(), 0.0);
+	for (auto const &mark : slot.marks) {
+		GLuint64 begin = stamps[mark.begin_query];
+		GLuint64 end = stamps[mark.end_query];
+		if (end > begin) ms[mark.timer] += (end - begin) / 1.0e6;
+	}
+	for (uint32_t t = 0; t < timers.size(); ++t) {
+		timers[t].gpu.push(float(ms[t]), window);
+	}
+	gpu_frames += 1;
+	slot.pending = false;
+	return true;
+}
+
+void FrameTimers::begin_frame() {
+	assert(open.empty());
+	Clock::time_point now = Clock::now();
+	if (have_frame_begin) {
+		frame_time.push(std::chrono::duration< float, std::milli >(now - frame_begin).count(), window);
+	}
+	frame_begin = now;
+	have_frame_begin = true;
+
+	//this slot was last recorded 'ring' frames ago; read it back if the GPU is done with it:
+	Slot &slot = slots[current];
+	if (slot.pending && !collect(slot, false)) {
+		gpu_dropped += 1;
+		slot.pending = false; //(its queries are simply issued again)
+	}
+	slot.used = 0;
+	slot.marks.clear();
+}
+
+void FrameTimers::begin(char const *name) {
+	Open scope;
+	scope.timer = timer_index(name);
+	scope.mark = -1U;
+	if (gpu) {
+		Slot &slot = slots[current];
+		Mark mark;
+		mark.timer = scope.timer;
+		mark.begin_query = next_query(slot);
+		mark.end_query = -1U;
+		glQueryCounter(slot.queries[mark.begin_query], GL_TIMESTAMP);
+		scope.mark = slot.marks.size();
+		slot.marks.emplace_back(mark);
+	}
+	scope.begin = Clock::now(); //(last, so query overhead isn't counted)
+	open.emplace_back(scope);
+}
+
+void FrameTimers::end() {
+	Clock::time_point now = Clock::now();
+	assert(!open.empty());
+	Open const &scope = open.back();
+	timers[scope.timer].cpu_frame += std::chrono::duration< float, std::milli >(now - scope.begin).count();
+	if (scope.mark != -1U) {
+		Slot &slot = slots[current];
+		Mark &mark = slot.marks[scope.mark];
+		mark.end_query = next_query(slot);
+		glQueryCounter(slot.queries[mark.end_query], GL_TIMESTAMP);
+	}
+	open.pop_back();
+}
+
+void FrameTimers::count(char const *name, uint32_t amount) {
+	for (auto &counter : counters) {
+		if (std::strcmp(counter.name.c_str(), name) == 0) {
+			counter.frame += amount;
+			return;
+		}
+	}
+	counters.emplace_back();
+	counters.back().name = name;
+	counters.back().frame = amount;
+}
+
+void FrameTimers::end_frame() {
+	assert(open.empty());
+	for (auto &timer : timers) {
+		timer.cpu.push(timer.cpu_frame, window);
+		timer.cpu_frame = 0.0f;
+	}
+	for (auto &counter : counters) {
+		counter.values.push(float(counter.frame), window);
+		counter.frame = 0;
+	}
+	Slot &slot = slots[current];
+	slot.pending = (gpu && !slot.marks.empty());
+	if (slot.pending) glFlush(); //(so the queries reach the GPU even if nothing else submits this frame -- say, headless)
+	current = (current + 1) % slots.size();
+	frames += 1;
+}
+
+void FrameTimers::finish() {
+	//oldest first, so the rolling windows stay in frame order:
+	for (uint32_t i = 0; i < slots.size(); ++i) {
+		Slot &slot = slots[(current + i) % slots.size()];
+		if (slot.pending) collect(slot, true);
+	}
+}
+
+void FrameTimers::report(std::ostream &out) const {
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(2);
+
+	float frame_ms = frame_time.average();
+	out << "Frame time over the last " << frame_time.values.size() << " frames: " << frame_ms << "ms average, " << frame_time.max() << "ms max";
+	if (frame_ms > 0.0f) out << " (" << std::setprecision(1) << 1000.0f / frame_ms << " fps)" << std::setprecision(2);
+	out << ".";
+	if (gpu) out << " GPU times read back for " << gpu_frames << " frames (" << gpu_dropped << " dropped: not ready in time).";
+	out << "\n";
+
+	size_t width = 6;
+	for (auto const &timer : timers) {
+		width = std::max(width, 2 * timer.depth + timer.name.size());
+	}
+	out << "  " << std::left << std::setw(width) << "scope" << std::right
+		<< "  " << std::setw(9) << "cpu avg" << std::setw(9) << "max"
+		<< "  " << std::setw(9) << "gpu avg" << std::setw(9) << "max" << "\n";
+	for (auto const &timer : timers) {
+		out << "  " << std::left << std::setw(width) << (std::string(2 * timer.depth, ' ') + timer.name) << std::right
+			<< "  " << std::setw(9) << timer.cpu.average() << std::setw(9) << timer.cpu.max();
+		if (gpu && !timer.gpu.values.empty()) {
+			out << "  " << std::setw(9) << timer.gpu.average() << std::setw(9) << timer.gpu.max();
+		} else {
+			out << "  " << std::setw(9) << "-" << std::setw(9) << "-";
+		}
+		out << "\n";
+	}
+	if (!counters.empty()) {
+		out << "  per frame (avg, max):";
+		for (uint32_t c = 0; c < counters.size(); ++c) {
+			out << " " << counters[c].name << " " << counters[c].values.average() << ", " << std::setprecision(0) << counters[c].values.max() << std::setprecision(2) << (c + 1 < counters.size() ? ";" : "");
+		}
+		out << "\n";
+	}
+	out.flush();
+
+	out.flags(flags);
+	out.precision(precision);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ostream>
+#include <stdint.h>
+
+//"FrameTimers" breaks each frame's time down by named (and possibly nested) scopes,
+// on both the CPU and the GPU, and keeps rolling averages over the last 'window' frames:
+// - CPU time is the wall-clock time between a scope's begin() and end();
+// - GPU time comes from GL_TIMESTAMP queries (glQueryCounter) issued at begin() and end(),
+//   i.e., the time the GPU took to get from one point in the command stream to the other
+//   (timestamps, unlike GL_TIME_ELAPSED queries, can nest);
+// - each frame's queries come from one slot of a ring; a slot's results are read when the
+//   slot comes around again, 'ring' frames later, if they're ready -- if they aren't, that
+//   frame's GPU times are dropped (and counted in 'gpu_dropped') rather than waited for.
+// Scopes with no GPU work (say, waiting on a file) still get a GPU time: whatever the GPU
+// was busy with -- or idle for -- meanwhile.
+struct FrameTimers {
+	//make queries on the current context (if it has GL_TIMESTAMP; otherwise only CPU time is measured):
+	FrameTimers(uint32_t ring = 4, uint32_t window = 60);
+	~FrameTimers(); //(deletes the queries; the context must still be current)
+	FrameTimers(FrameTimers const &) = delete;
+	FrameTimers &operator=(FrameTimers const &) = delete;
+
+	//GL thread: bracket each frame (and every scope) with these:
+	void begin_frame(); //(reads back the GPU times of the frame 'ring' frames ago, if they're ready)
+	void begin(char const *name); //(scopes are told apart by name; one may run several times a frame)
+	void end(); //(ends the innermost scope)
+	void end_frame();
+
+	//a scope that ends with the block it's in; does nothing if 'timers' is null:
+	struct Scope {
+		Scope(FrameTimers *timers_, char const *name) : timers(timers_) { if (timers) timers->begin(name); }
+		~Scope() { if (timers) timers->end(); }
+		Scope(Scope const &) = delete;
+		Scope &operator=(Scope const &) = delete;
+		FrameTimers *timers;
+	};
+
+	//add to this frame's count of something (e.g., driver debug messages), reported alongside the times:
+	void count(char const *name, uint32_t amount);
+
+	//GL thread: wait for the GPU, and read back every frame still in flight:
+	void finish();
+
+	//print the rolling breakdown, one line per scope (indented by nesting), in milliseconds, then the counts per frame:
+	void report(std::ostream &out) const;
+
+	bool gpu = false; //GL_TIMESTAMP queries work on this context
+	uint32_t frames = 0; //frames ended
+	uint32_t gpu_frames = 0; //frames whose GPU times were read back
+	uint32_t gpu_dropped = 0; //frames whose GPU times weren't ready in time
+
+	//internals:
+	typedef std::chrono::high_resolution_clock Clock;
+	uint32_t window;
+	//the last 'window' values of something:
+	struct Rolling {
+		std::vector< float > values;
+		uint32_t next = 0;
+		void push(float value, uint32_t window);
+		float average() const;
+		float max() const;
+	};
+	struct Timer {
+		std::string name;
+		uint32_t depth = 0; //scopes it's nested in (when it was first seen)
+		float cpu_frame = 0.0f; //ms so far this frame
+		Rolling cpu, gpu;
+	};
+	std::vector< Timer > timers; //(in the order they were first begun)
+	struct Counter {
+		std::string name;
+		uint32_t frame = 0; //so far this frame
+		Rolling values;
+	};
+	std::vector< Counter > counters; //(in the order they were first counted)
+	Rolling frame_time; //ms between begin_frame()s
+	Clock::time_point frame_begin;
+	bool have_frame_begin = false;
+	//scopes begun but not yet ended:
+	struct Open {
+		uint32_t timer;
+		Clock::time_point begin;
+		uint32_t mark; //in the slot's marks (-1U without GPU timing)
+	};
+	std::vector< Open > open;
+	//one frame's queries:
+	struct Mark {
+		uint32_t timer;
+		uint32_t begin_query, end_query; //in queries
+	};
+	struct Slot {
+		std::vector< GLuint > queries; //(grows as needed; reused)
+		uint32_t used = 0;
+		std::vector< Mark > marks;
+		bool pending = false; //queries issued, results not read yet
+	};
+	std::vector< Slot > slots;
+	uint32_t current = 0; //slot being recorded
+	uint32_t timer_index(char const *name);
+	GLuint next_query(Slot &slot);
+	bool collect(Slot &slot, bool wait); //read a pending slot's results, if they're ready (or if 'wait'); returns false if they weren't
+};
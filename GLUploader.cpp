@@ -0,0 +1,121 @@
+#include "GLUploader.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <chrono>
+#include <cassert>
+
+GLUploader::GLUploader(SDL_Window *window_, SDL_GLContext context) : to_upload(16), uploaded(16), window(window_) {
+	if (!window) return; //(no SDL window to share a context with)
+
+	SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+	upload_context = SDL_GL_CreateContext(window); //(makes the new context current, if it works)
+	SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+	SDL_GL_MakeCurrent(window, context);
+
+	if (!upload_context) {
+		std::cerr << "NOTE: couldn't create a shared upload context (" << SDL_GetError() << "); uploading on the main thread." << std::endl;
+		return;
+	}
+	thread = std::thread(&GLUploader::run, this);
+}
+
+GLUploader::~GLUploader() {
+	stop();
+}
+
+void GLUploader::stop() {
+	quit.store(true);
+	if (thread.joinable()) thread.join();
+	if (upload_context) {
+		SDL_GL_DeleteContext(upload_context);
+		upload_context = nullptr;
+	}
+	//(buffers of uploads nobody popped are left for context teardown)
+	for (auto const &upload : in_flight) {
+		glDeleteSync(upload.fence);
+	}
+	in_flight.clear();
+}
+
+void GLUploader::push(StagedMesh &&staged) {
+	pushed += 1;
+	if (!upload_context) {
+		in_flight.emplace_back(upload(std::move(staged)));
+		return;
+	}
+	bool pushed_ok = to_upload.push(std::move(staged));
+	assert(pushed_ok && "push() only when can_push()");
+	(void)pushed_ok;
+}
+
+bool GLUploader::pop(UploadedMesh *mesh) {
+	assert(mesh);
+	Upload upload;
+	while (uploaded.pop(&upload)) {
+		in_flight.emplace_back(upload);
+	}
+	if (in_flight.empty()) return false;
+
+	//uploads finish in order, so only the oldest fence needs checking:
+	Upload &front = in_flight.front();
+	GLenum status = glClientWaitSync(front.fence, 0, 0); //(zero timeout: just poll)
+	if (status == GL_TIMEOUT_EXPIRED) return false;
+	if (status == GL_WAIT_FAILED) {
+		throw std::runtime_error("Failed to check upload fence.");
+	}
+	glDeleteSync(front.fence);
+	//NOTE: the buffers are bound again (in this context) before use, which is what makes
+	// the other context's writes visible here now that the fence has signaled.
+	*mesh = std::move(front.mesh);
+	in_flight.pop_front();
+	popped += 1;
+	return true;
+}
+
+GLUploader::Upload GLUploader::upload(StagedMesh &&staged) {
+	assert(staged.data.size() == staged.colors.size() && staged.data.size() == staged.texcoords.size());
+	Upload upload;
+	upload.mesh.vertices = staged.data.size();
+	//(aliases have no vertices of their own, but still get a fence, so they stay in order behind the mesh they share)
+
+	auto fill = [](GLuint *buffer, size_t size, void const *data) {
+		glGenBuffers(1, buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, *buffer);
+		glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+	};
+	if (!staged.alias) {
+		fill(&upload.mesh.buffer, staged.data.size() * sizeof(v3n3), staged.data.data());
+		fill(&upload.mesh.color_buffer, staged.colors.size() * sizeof(c4ub), staged.colors.data());
+		fill(&upload.mesh.texcoord_buffer, staged.texcoords.size() * sizeof(t2f), staged.texcoords.data());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush(); //(fences only signal once they've been sent to the GPU)
+
+	upload.mesh.info = std::move(staged);
+	upload.mesh.info.data = std::vector< v3n3 >();
+	upload.mesh.info.colors = std::vector< c4ub >();
+	upload.mesh.info.texcoords = std::vector< t2f >();
+	return upload;
+}
+
+void GLUploader::run() {
+	SDL_GL_MakeCurrent(window, upload_context);
+
+	StagedMesh staged;
+	while (!quit.load()) {
+		if (!to_upload.pop(&staged)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		Upload done = upload(std::move(staged));
+		while (!uploaded.push(std::move(done))) {
+			if (quit.load()) break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	SDL_GL_MakeCurrent(window, nullptr);
+}
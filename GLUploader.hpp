@@ -0,0 +1,56 @@
+#pragma once
+
+#include "GL.hpp"
+#include "Meshes.hpp"
+#include "spsc_queue.hpp"
+
+#include <SDL.h>
+
+#include <thread>
+#include <atomic>
+#include <deque>
+
+//"GLUploader" copies staged meshes into GL buffers on a thread with its own
+// OpenGL context (shared with the main one), so big glBufferData calls don't
+// stall the render loop:
+// - the GL thread push()es staged meshes (e.g., from AssetLoader);
+// - the upload thread fills buffers (v3n3, c4ub, t2f) per mesh, then fences them;
+// - pop() returns meshes whose fences have signaled, for Meshes::add_uploaded().
+// If a shared context can't be made, push() does the upload itself (same results).
+struct GLUploader {
+	//'context' must be current (on the calling thread) and is current again on return:
+	// note: pass a null 'window' (e.g., when rendering headless) to always upload in push().
+	GLUploader(SDL_Window *window, SDL_GLContext context);
+	~GLUploader(); //calls stop()
+	//stop (and join) the upload thread and delete its context; call before the window goes away:
+	void stop();
+	GLUploader(GLUploader const &) = delete;
+	GLUploader &operator=(GLUploader const &) = delete;
+
+	//GL thread: is there room to push()?
+	bool can_push() const { return !to_upload.full(); }
+	//GL thread: queue a mesh for upload (call only if can_push()):
+	void push(StagedMesh &&staged);
+	//GL thread: take the next finished upload, if its fence has signaled; never waits:
+	bool pop(UploadedMesh *uploaded);
+	//GL thread: nothing pushed is still waiting to be popped:
+	bool idle() const { return pushed == popped; }
+
+	//internals:
+	struct Upload {
+		UploadedMesh mesh;
+		GLsync fence = 0;
+	};
+	SPSCQueue< StagedMesh > to_upload; //GL thread -> upload thread
+	SPSCQueue< Upload > uploaded; //upload thread -> GL thread
+	std::deque< Upload > in_flight; //(GL thread only) popped from 'uploaded', fence not yet checked/signaled
+	uint32_t pushed = 0, popped = 0; //(GL thread only)
+
+	SDL_Window *window = nullptr;
+	SDL_GLContext upload_context = nullptr; //nullptr => uploads happen in push()
+	std::atomic< bool > quit{false};
+	std::thread thread;
+
+	void run(); //(upload thread)
+	static Upload upload(StagedMesh &&staged); //fill buffers + fence (on whichever thread has a context current)
+};
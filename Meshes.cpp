@@ -8,88 +8,541 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <map>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
 
-void Meshes::load(std::string const &filename, Attributes const &attributes) {
-	std::ifstream file(filename, std::ios::binary);
+struct IndexEntry {
+	uint32_t name_begin, name_end;
+	uint32_t vertex_start, vertex_count;
+};
+static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
 
-	GLuint vao = 0;
-	GLuint total = 0;
-	{ //read + upload data chunk:
-		struct v3n3 {
-			glm::vec3 v;
-			glm::vec3 n;
-		};
-		static_assert(sizeof(v3n3) == 24, "v3n3 is packed");
-		std::vector< v3n3 > data;
-		read_chunk(file, "v3n3", &data);
+//coarser levels of detail for the idx0 entry with the same index:
+struct LodEntry {
+	uint32_t count;
+	struct { uint32_t vertex_start, vertex_count; } levels[Mesh::MaxLODs];
+};
+static_assert(sizeof(LodEntry) == 4 + 8 * Mesh::MaxLODs, "Lod entry should be packed");
 
-		//upload data:
-		GLuint buffer = 0;
-		glGenBuffers(1, &buffer);
-		glBindBuffer(GL_ARRAY_BUFFER, buffer);
-		//how big data is
-		glBufferData(GL_ARRAY_BUFFER, sizeof(v3n3) * data.size(), &data[0], GL_STATIC_DRAW);
+//point attributes of the currently-bound VAO at v3n3 data, c4ub data, and t2f data:
+static void point_attributes(Meshes::Attributes const &attributes, GLuint data_buffer, GLuint color_buffer, GLuint texcoord_buffer) {
+	glBindBuffer(GL_ARRAY_BUFFER, data_buffer);
+	if (attributes.Position != -1U) {
+		glVertexAttribPointer(attributes.Position, 3, GL_FLOAT, GL_FALSE, sizeof(v3n3), (GLbyte *)0);
+		glEnableVertexAttribArray(attributes.Position);
+	}
+	if (attributes.Normal != -1U) {
+		glVertexAttribPointer(attributes.Normal, 3, GL_FLOAT, GL_FALSE, sizeof(v3n3), (GLbyte *)0 + sizeof(glm::vec3));
+		glEnableVertexAttribArray(attributes.Normal);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, color_buffer);
+	if (attributes.Color != -1U) {
+		glVertexAttribPointer(attributes.Color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(c4ub), (GLbyte *)0);
+		glEnableVertexAttribArray(attributes.Color);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, texcoord_buffer);
+	if (attributes.TexCoord != -1U) {
+		glVertexAttribPointer(attributes.TexCoord, 2, GL_FLOAT, GL_FALSE, sizeof(t2f), (GLbyte *)0);
+		glEnableVertexAttribArray(attributes.TexCoord);
+	}
+}
 
-		total = data.size(); //store total for later checks on index
+//read 'count' elements starting at vertex 'start' from an optional per-vertex chunk (c4ub or t2f0),
+// or fill them with 'missing' if the file doesn't have that chunk:
+template< typename T >
+static void read_per_vertex(std::istream &file, ChunkInfo const *chunk, GLuint start, GLuint count, T const &missing, T *out) {
+	assert(out || count == 0);
+	if (!chunk) {
+		std::fill(out, out + count, missing);
+		return;
+	}
+	if (count == 0) return;
+	file.seekg(chunk->offset + std::streamoff(start) * sizeof(T), std::ios::beg);
+	if (!file.read(reinterpret_cast< char * >(out), count * sizeof(T))) {
+		throw std::runtime_error("Failed to read per-vertex data.");
+	}
+}
 
-		//store binding:
-		glGenVertexArrays(1, &vao);
-		glBindVertexArray(vao);
-		if (attributes.Position != -1U) {
-			glVertexAttribPointer(attributes.Position, 3, GL_FLOAT, GL_FALSE, sizeof(v3n3), (GLbyte *)0);
-			glEnableVertexAttribArray(attributes.Position);
-		} else {
-			std::cerr << "WARNING: loading v3n3 data from '" << filename << "', but not using the Position attribute." << std::endl;
-		}
-		if (attributes.Normal != -1U) {
-			glVertexAttribPointer(attributes.Normal, 3, GL_FLOAT, GL_FALSE, sizeof(v3n3), (GLbyte *)0 + sizeof(glm::vec3));
-			glEnableVertexAttribArray(attributes.Normal);
-		} else {
-			std::cerr << "WARNING: loading v3n3 data from '" << filename << "', but not using the Normal attribute." << std::endl;
-		}
+static c4ub const White = {0xff, 0xff, 0xff, 0xff};
+static t2f const Origin = {glm::vec2(0.0f)};
+
+//compute a bounding sphere (center of the bounding box, and radius around that):
+template< typename T >
+static void bound_mesh(v3n3 const *data, GLuint count, T *mesh_) {
+	assert(mesh_);
+	auto &mesh = *mesh_;
+	if (count == 0) return;
+	glm::vec3 min = data[0].v;
+	glm::vec3 max = data[0].v;
+	for (GLuint i = 1; i < count; ++i) {
+		min = glm::min(min, data[i].v);
+		max = glm::max(max, data[i].v);
+	}
+	mesh.center = 0.5f * (min + max);
+	float radius2 = 0.0f;
+	for (GLuint i = 0; i < count; ++i) {
+		glm::vec3 d = data[i].v - mesh.center;
+		radius2 = std::max(radius2, glm::dot(d, d));
+	}
+	mesh.radius = std::sqrt(radius2);
+}
+
+//does any color have alpha below 1?
+static bool any_translucent(c4ub const *colors, GLuint count) {
+	for (GLuint i = 0; i < count; ++i) {
+		if (colors[i].a != 0xff) return true;
+	}
+	return false;
+}
+
+static void warn_unused_attributes(std::string const &filename, Meshes::Attributes const &attributes) {
+	if (attributes.Position == -1U) {
+		std::cerr << "WARNING: loading v3n3 data from '" << filename << "', but not using the Position attribute." << std::endl;
+	}
+	if (attributes.Normal == -1U) {
+		std::cerr << "WARNING: loading v3n3 data from '" << filename << "', but not using the Normal attribute." << std::endl;
+	}
+}
+
+void Meshes::read_index(std::istream &file, std::string const &filename, FileIndex *index_) {
+	assert(index_);
+	auto &out = *index_;
+	out = FileIndex();
+	out.filename = filename;
+
+	std::vector< ChunkInfo > toc = index_chunks(file, &out.trailing);
+	ChunkInfo const *data_chunk = find_chunk(toc, "v3n3");
+	ChunkInfo const *strings_chunk = find_chunk(toc, "str0");
+	ChunkInfo const *index_chunk = find_chunk(toc, "idx0");
+	ChunkInfo const *colors_chunk = find_chunk(toc, "c4ub"); //optional
+	ChunkInfo const *texcoords_chunk = find_chunk(toc, "t2f0"); //optional
+	if (!data_chunk || !strings_chunk || !index_chunk) {
+		throw std::runtime_error("Mesh file '" + filename + "' is missing a v3n3, str0, or idx0 chunk");
+	}
+	if (data_chunk->size % sizeof(v3n3) != 0) {
+		throw std::runtime_error("Size of chunk not divisible by element size");
 	}
 
+	GLuint total = data_chunk->size / sizeof(v3n3); //store total for later checks on index
+	if (colors_chunk && colors_chunk->size != total * sizeof(c4ub)) {
+		throw std::runtime_error("Mesh file '" + filename + "' has a c4ub chunk that doesn't match its v3n3 chunk");
+	}
+	out.data_offset = data_chunk->offset;
+	out.total = total;
+	if (texcoords_chunk && texcoords_chunk->size != total * sizeof(t2f)) {
+		throw std::runtime_error("Mesh file '" + filename + "' has a t2f0 chunk that doesn't match its v3n3 chunk");
+	}
+	out.has_colors = (colors_chunk != nullptr);
+	if (colors_chunk) out.colors_chunk = *colors_chunk;
+	out.has_texcoords = (texcoords_chunk != nullptr);
+	if (texcoords_chunk) out.texcoords_chunk = *texcoords_chunk;
+
 	std::vector< char > strings;
-	read_chunk(file, "str0", &strings);
+	read_chunk(file, *strings_chunk, &strings);
 
-	{ //read index chunk, add to meshes:
-		struct IndexEntry {
-			uint32_t name_begin, name_end;
-			uint32_t vertex_start, vertex_count;
-		};
-		static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
+	std::vector< IndexEntry > index;
+	read_chunk(file, *index_chunk, &index);
+
+	//ids are hashed at export time; older files without them get hashed here:
+	std::vector< MeshID > ids;
+	if (ChunkInfo const *ids_chunk = find_chunk(toc, "id64")) {
+		read_chunk(file, *ids_chunk, &ids);
+		if (ids.size() != index.size()) {
+			throw std::runtime_error("id64 chunk size doesn't match idx0 chunk size");
+		}
+	}
+
+	//levels of detail are optional too:
+	std::vector< LodEntry > lods;
+	if (ChunkInfo const *lods_chunk = find_chunk(toc, "lod0")) {
+		read_chunk(file, *lods_chunk, &lods);
+		if (lods.size() != index.size()) {
+			throw std::runtime_error("lod0 chunk size doesn't match idx0 chunk size");
+		}
+	}
 
-		std::vector< IndexEntry > index;
-		read_chunk(file, "idx0", &index);
+	//entries that share vertices, keyed by (start, count) of every level:
+	std::map< std::vector< uint32_t >, uint32_t > ranges;
 
-		for (auto const &entry : index) {
-			if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
-				throw std::runtime_error("index entry has out-of-range name begin/end");
+	out.entries.reserve(index.size());
+	for (uint32_t i = 0; i < index.size(); ++i) {
+		IndexEntry const &entry = index[i];
+		if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
+			throw std::runtime_error("index entry has out-of-range name begin/end");
+		}
+		if (!(entry.vertex_start < entry.vertex_start + entry.vertex_count && entry.vertex_start + entry.vertex_count <= total)) {
+			throw std::runtime_error("index entry has out-of-range vertex start/count");
+		}
+		char const *name_begin = &strings[0] + entry.name_begin;
+		char const *name_end = &strings[0] + entry.name_end;
+
+		FileEntry file_entry;
+		file_entry.id = (ids.empty() ? mesh_id(name_begin, name_end) : ids[i]);
+		file_entry.name = std::string(name_begin, name_end);
+		if (file_entry.id == 0) {
+			throw std::runtime_error("mesh name '" + file_entry.name + "' hashes to the reserved id 0");
+		}
+		file_entry.vertex_start = entry.vertex_start;
+		file_entry.vertex_count = entry.vertex_count;
+		if (!lods.empty()) {
+			if (lods[i].count > Mesh::MaxLODs) {
+				throw std::runtime_error("lod0 entry has too many levels");
 			}
-			if (!(entry.vertex_start < entry.vertex_start + entry.vertex_count && entry.vertex_start + entry.vertex_count <= total)) {
-				throw std::runtime_error("index entry has out-of-range vertex start/count");
+			file_entry.lod_count = lods[i].count;
+			for (uint32_t l = 0; l < lods[i].count; ++l) {
+				auto const &level = lods[i].levels[l];
+				if (!(level.vertex_start < level.vertex_start + level.vertex_count && level.vertex_start + level.vertex_count <= total)) {
+					throw std::runtime_error("lod0 entry has out-of-range vertex start/count");
+				}
+				file_entry.lods[l].start = level.vertex_start;
+				file_entry.lods[l].count = level.vertex_count;
 			}
-			std::string name(&strings[0] + entry.name_begin, &strings[0] + entry.name_end);
-			Mesh mesh;
-			mesh.vao = vao;
-			mesh.start = entry.vertex_start;
-			mesh.count = entry.vertex_count;
-			bool inserted = meshes.insert(std::make_pair(name, mesh)).second;
-			if (!inserted) {
-				std::cerr << "WARNING: mesh name '" + name + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
+		}
+		std::vector< uint32_t > range{file_entry.vertex_start, file_entry.vertex_count};
+		for (uint32_t l = 0; l < file_entry.lod_count; ++l) {
+			range.emplace_back(file_entry.lods[l].start);
+			range.emplace_back(file_entry.lods[l].count);
+		}
+		auto shared = ranges.insert(std::make_pair(range, i));
+		if (!shared.second) file_entry.same_as = shared.first->second;
+		out.entries.emplace_back(file_entry);
+	}
+}
+
+void Meshes::read_staged(std::istream &file, FileIndex const &index, FileEntry const &entry, StagedMesh *staged_) {
+	assert(staged_);
+	auto &staged = *staged_;
+	staged.id = entry.id;
+	staged.name = entry.name;
+	staged.count = entry.vertex_count;
+	staged.lod_count = entry.lod_count;
+
+	GLuint total = entry.vertex_count;
+	for (uint32_t l = 0; l < entry.lod_count; ++l) {
+		staged.lod_counts[l] = entry.lods[l].count;
+		total += entry.lods[l].count;
+	}
+	staged.data.resize(total);
+	staged.colors.resize(total);
+	staged.texcoords.resize(total);
+	staged.has_texcoords = index.has_texcoords;
+
+	//levels aren't necessarily next to each other in the file, so read them one at a time:
+	GLuint at = 0;
+	auto read_range = [&](GLuint start, GLuint count) {
+		file.seekg(index.data_offset + std::streamoff(start) * sizeof(v3n3), std::ios::beg);
+		if (!file.read(reinterpret_cast< char * >(&staged.data[at]), count * sizeof(v3n3))) {
+			throw std::runtime_error("Failed to read mesh vertices from '" + index.filename + "'");
+		}
+		read_per_vertex(file, (index.has_colors ? &index.colors_chunk : nullptr), start, count, White, &staged.colors[at]);
+		read_per_vertex(file, (index.has_texcoords ? &index.texcoords_chunk : nullptr), start, count, Origin, &staged.texcoords[at]);
+		at += count;
+	};
+	read_range(entry.vertex_start, entry.vertex_count);
+	for (uint32_t l = 0; l < entry.lod_count; ++l) {
+		read_range(entry.lods[l].start, entry.lods[l].count);
+	}
+
+	bound_mesh(&staged.data[0], staged.count, &staged);
+	staged.translucent = any_translucent(&staged.colors[0], staged.count);
+}
+
+void Meshes::load(std::string const &filename, Attributes const &attributes, UploadMode mode) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Failed to open mesh file '" + filename + "'");
+	}
+
+	FileIndex index;
+	read_index(file, filename, &index);
+
+	warn_unused_attributes(filename, attributes);
+	if (index.has_colors && attributes.Color == -1U) {
+		std::cerr << "WARNING: loading c4ub data from '" << filename << "', but not using the Color attribute." << std::endl;
+	}
+	if (index.has_texcoords && attributes.TexCoord == -1U) {
+		std::cerr << "WARNING: loading t2f0 data from '" << filename << "', but not using the TexCoord attribute." << std::endl;
+	}
+
+	GLuint vao = vao_for(attributes);
+	GLuint base = 0; //where this file's v3n3 chunk starts in the arena (UploadAll)
+	std::vector< v3n3 > data; //(UploadAll; kept around for bounding spheres)
+	std::vector< c4ub > colors; //(UploadAll; kept around for translucency)
+	if (mode == UploadAll) { //read + append data chunk to the arena:
+		//(entries with the same vertices point at the same part of the arena, so they're shared automatically)
+		data.resize(index.total);
+		file.seekg(index.data_offset, std::ios::beg);
+		if (!file.read(reinterpret_cast< char * >(&data[0]), data.size() * sizeof(v3n3))) {
+			throw std::runtime_error("Failed to read chunk data.");
+		}
+		colors.resize(index.total);
+		read_per_vertex(file, (index.has_colors ? &index.colors_chunk : nullptr), 0, index.total, White, &colors[0]);
+		std::vector< t2f > texcoords(index.total);
+		read_per_vertex(file, (index.has_texcoords ? &index.texcoords_chunk : nullptr), 0, index.total, Origin, &texcoords[0]);
+		base = append(&data[0], &colors[0], &texcoords[0], index.total);
+	}
+
+	reserve_slots(index.entries.size());
+	for (uint32_t i = 0; i < index.entries.size(); ++i) {
+		FileEntry const &entry = index.entries[i];
+		Slot &slot = find_slot(entry.id);
+		if (slot.id != 0) {
+			std::cerr << "WARNING: mesh name '" + entry.name + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
+			continue;
+		}
+		slot.id = entry.id;
+		slots_used += 1;
+		if (mode == UploadAll) {
+			slot.mesh.vao = vao;
+			slot.mesh.start = base + entry.vertex_start;
+			slot.mesh.count = entry.vertex_count;
+			slot.mesh.lod_count = entry.lod_count;
+			for (uint32_t l = 0; l < entry.lod_count; ++l) {
+				slot.mesh.lods[l].start = base + entry.lods[l].start;
+				slot.mesh.lods[l].count = entry.lods[l].count;
 			}
+			bound_mesh(&data[entry.vertex_start], entry.vertex_count, &slot.mesh);
+			slot.mesh.translucent = any_translucent(&colors[entry.vertex_start], entry.vertex_count);
+			slot.mesh.has_texcoords = index.has_texcoords;
+		} else {
+			Pending p;
+			p.source = sources.size();
+			p.entry = i;
+			slot.pending = pending.size();
+			pending.emplace_back(p);
 		}
 	}
 
-	if (file.peek() != EOF) {
+	if (index.trailing) {
 		std::cerr << "WARNING: trailing data in mesh file '" + filename + "'" << std::endl;
 	}
+
+	if (mode == UploadOnDemand) { //remember where to find the data chunk later:
+		Source source;
+		source.index = std::move(index);
+		source.vao = vao;
+		sources.emplace_back(std::move(source));
+	}
+}
+
+void Meshes::add_staged(StagedMesh const &staged, Attributes const &attributes) {
+	if (staged.alias) {
+		add_alias(staged.id, staged.name, staged.alias);
+		return;
+	}
+	reserve_slots(1);
+	Slot &slot = find_slot(staged.id);
+	if (slot.id != 0) {
+		std::cerr << "WARNING: mesh name '" + staged.name + "' collides with existing mesh." << std::endl;
+		return;
+	}
+	slot.id = staged.id;
+	slots_used += 1;
+	GLuint start = append(&staged.data[0], &staged.colors[0], &staged.texcoords[0], staged.data.size());
+	point_mesh(staged, vao_for(attributes), start, &slot.mesh);
+}
+
+void Meshes::add_uploaded(UploadedMesh const &uploaded, Attributes const &attributes) {
+	if (uploaded.info.alias) {
+		add_alias(uploaded.info.id, uploaded.info.name, uploaded.info.alias);
+		return;
+	}
+	reserve_slots(1);
+	Slot &slot = find_slot(uploaded.info.id);
+	if (slot.id != 0) {
+		std::cerr << "WARNING: mesh name '" + uploaded.info.name + "' collides with existing mesh." << std::endl;
+	} else {
+		slot.id = uploaded.info.id;
+		slots_used += 1;
+
+		//copy from the upload buffers to the end of the arena (entirely on the GPU):
+		reserve_arena(uploaded.vertices);
+		auto copy = [&](GLuint from, GLuint to, size_t element_size) {
+			glBindBuffer(GL_COPY_READ_BUFFER, from);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, to);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, element_size * arena.used, element_size * uploaded.vertices);
+		};
+		copy(uploaded.buffer, arena.buffer, sizeof(v3n3));
+		copy(uploaded.color_buffer, arena.color_buffer, sizeof(c4ub));
+		copy(uploaded.texcoord_buffer, arena.texcoord_buffer, sizeof(t2f));
+		GLuint start = arena.used;
+		arena.used += uploaded.vertices;
+
+		point_mesh(uploaded.info, vao_for(attributes), start, &slot.mesh);
+	}
+
+	GLuint buffers[3] = {uploaded.buffer, uploaded.color_buffer, uploaded.texcoord_buffer};
+	glDeleteBuffers(3, buffers);
+}
+
+bool Meshes::add_alias(MeshID id, std::string const &name, MeshID alias) {
+	Mesh const *mesh = find(alias);
+	if (!mesh) {
+		std::cerr << "WARNING: mesh '" + name + "' shares the vertices of a mesh that isn't loaded." << std::endl;
+		return false;
+	}
+	Mesh shared = *mesh; //(copied: reserve_slots can move it)
+	reserve_slots(1);
+	Slot &slot = find_slot(id);
+	if (slot.id != 0) {
+		std::cerr << "WARNING: mesh name '" + name + "' collides with existing mesh." << std::endl;
+		return false;
+	}
+	slot.id = id;
+	slots_used += 1;
+	slot.mesh = shared;
+	return true;
+}
+
+Meshes::Slot &Meshes::find_slot(MeshID id) {
+	assert(!slots.empty());
+	size_t mask = slots.size() - 1;
+	for (size_t i = size_t(id) & mask; ; i = (i + 1) & mask) {
+		if (slots[i].id == id || slots[i].id == 0) return slots[i];
+	}
+}
+
+void Meshes::reserve_slots(size_t count) {
+	if (2 * (slots_used + count) <= slots.size()) return;
+	size_t size = 16;
+	while (size < 2 * (slots_used + count)) size *= 2;
+	std::vector< Slot > old;
+	old.swap(slots);
+	slots.resize(size);
+	for (auto const &slot : old) {
+		if (slot.id != 0) find_slot(slot.id) = slot;
+	}
+}
+
+Mesh const *Meshes::find(MeshID id) {
+	if (slots.empty()) return nullptr;
+	Slot &slot = find_slot(id);
+	if (slot.id != id || slot.pending != -1U) return nullptr;
+	return &slot.mesh;
 }
 
-Mesh const &Meshes::get(std::string const &name) const {
-	auto f = meshes.find(name);
-	if (f == meshes.end()) {
+Mesh const &Meshes::get(MeshID id) {
+	if (slots.empty()) {
 		throw std::runtime_error("Looking up mesh that doesn't exist.");
 	}
-	return f->second;
+	Slot &slot = find_slot(id);
+	if (slot.id != id) {
+		throw std::runtime_error("Looking up mesh that doesn't exist.");
+	}
+	if (slot.pending == -1U) {
+		return slot.mesh;
+	}
+
+	Pending const &p = pending[slot.pending];
+	Source const &source = sources[p.source];
+	FileEntry const &entry = source.index.entries[p.entry];
+
+	if (entry.same_as != -1U) { //shares an earlier entry's vertices, so upload those (once) instead:
+		Mesh shared = get(source.index.entries[entry.same_as].id);
+		slot.mesh = shared;
+		slot.pending = -1U;
+		return slot.mesh;
+	}
+
+	{ //read this mesh's vertices (and those of its levels of detail) from the file:
+		std::ifstream file(source.index.filename, std::ios::binary);
+		StagedMesh staged;
+		read_staged(file, source.index, entry, &staged);
+		GLuint start = append(&staged.data[0], &staged.colors[0], &staged.texcoords[0], staged.data.size());
+		point_mesh(staged, source.vao, start, &slot.mesh);
+	}
+	slot.pending = -1U;
+
+	return slot.mesh;
+}
+
+GLuint Meshes::vao_for(Attributes const &attributes) {
+	for (auto const &va : arena.vaos) {
+		if (va.first.Position == attributes.Position
+		 && va.first.Normal == attributes.Normal
+		 && va.first.Color == attributes.Color
+		 && va.first.TexCoord == attributes.TexCoord) {
+			return va.second;
+		}
+	}
+	GLuint vao = 0;
+	glGenVertexArrays(1, &vao);
+	if (arena.buffer) {
+		glBindVertexArray(vao);
+		point_attributes(attributes, arena.buffer, arena.color_buffer, arena.texcoord_buffer);
+	}
+	arena.vaos.emplace_back(attributes, vao);
+	return vao;
+}
+
+void Meshes::reserve_arena(GLuint count) {
+	//(vertex indices are GLuints, and the largest buffer's size has to fit a GLsizeiptr)
+	uint64_t const limit = std::min< uint64_t >(UINT32_MAX, uint64_t(PTRDIFF_MAX) / sizeof(v3n3));
+	uint64_t needed = uint64_t(arena.used) + count;
+	if (needed > limit) {
+		throw std::runtime_error("Mesh arena can't hold " + std::to_string(needed) + " vertices.");
+	}
+	if (needed > arena.capacity) { //grow (and re-point VAOs at) the arena buffers:
+		GLuint capacity = GLuint(std::min(limit, std::max(uint64_t(arena.capacity) * 2, needed)));
+		auto grow = [&](GLuint *buffer, size_t element_size) {
+			GLuint grown = 0;
+			glGenBuffers(1, &grown);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+			//(dynamic: meshes are written into it piece by piece, with glBufferSubData or glCopyBufferSubData,
+			// which drivers -- e.g., llvmpipe -- flag as a performance problem for GL_STATIC_DRAW buffers)
+			glBufferData(GL_COPY_WRITE_BUFFER, element_size * capacity, NULL, GL_DYNAMIC_DRAW);
+			if (*buffer) {
+				glBindBuffer(GL_COPY_READ_BUFFER, *buffer);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, element_size * arena.used);
+				glDeleteBuffers(1, buffer);
+			}
+			*buffer = grown;
+		};
+		grow(&arena.buffer, sizeof(v3n3));
+		grow(&arena.color_buffer, sizeof(c4ub));
+		grow(&arena.texcoord_buffer, sizeof(t2f));
+		arena.capacity = capacity;
+
+		for (auto const &va : arena.vaos) {
+			glBindVertexArray(va.second);
+			point_attributes(va.first, arena.buffer, arena.color_buffer, arena.texcoord_buffer);
+		}
+	}
+}
+
+GLuint Meshes::append(void const *data, void const *colors, void const *texcoords, GLuint count) {
+	reserve_arena(count);
+
+	glBindBuffer(GL_ARRAY_BUFFER, arena.buffer);
+	glBufferSubData(GL_ARRAY_BUFFER, sizeof(v3n3) * arena.used, sizeof(v3n3) * count, data);
+	glBindBuffer(GL_ARRAY_BUFFER, arena.color_buffer);
+	glBufferSubData(GL_ARRAY_BUFFER, sizeof(c4ub) * arena.used, sizeof(c4ub) * count, colors);
+	glBindBuffer(GL_ARRAY_BUFFER, arena.texcoord_buffer);
+	glBufferSubData(GL_ARRAY_BUFFER, sizeof(t2f) * arena.used, sizeof(t2f) * count, texcoords);
+
+	GLuint start = arena.used;
+	arena.used += count;
+	return start;
+}
+
+void Meshes::point_mesh(StagedMesh const &staged, GLuint vao, GLuint start, Mesh *mesh_) {
+	assert(mesh_);
+	auto &mesh = *mesh_;
+	mesh.vao = vao;
+	mesh.start = start;
+	mesh.count = staged.count;
+	mesh.lod_count = staged.lod_count;
+	GLuint at = start + staged.count;
+	for (uint32_t l = 0; l < staged.lod_count; ++l) {
+		mesh.lods[l].start = at;
+		mesh.lods[l].count = staged.lod_counts[l];
+		at += staged.lod_counts[l];
+	}
+	mesh.center = staged.center;
+	mesh.radius = staged.radius;
+	mesh.translucent = staged.translucent;
+	mesh.has_texcoords = staged.has_texcoords;
 }
@@ -1,13 +1,83 @@
 #pragma once
 
 #include "GL.hpp"
-#include <map>
+#include "mesh_id.hpp"
+#include "read_chunk.hpp"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include <ios>
 
 //Mesh is a lightweight handle to some OpenGL vertex data:
 struct Mesh {
 	GLuint vao = 0;
 	GLuint start = 0;
 	GLuint count = 0;
+	//coarser levels of detail (from the file's 'lod0' chunk, if any), drawn from the same vao:
+	struct LOD {
+		GLuint start = 0;
+		GLuint count = 0;
+	};
+	enum { MaxLODs = 3 };
+	uint32_t lod_count = 0;
+	LOD lods[MaxLODs];
+	//object-space bounding sphere of the full-detail vertices (used to pick a level):
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;
+	//some vertex color has alpha below 1 (so the mesh needs blending to look right):
+	bool translucent = false;
+	//texture coordinates came from the file (otherwise they're all zero, and texturing the mesh is pointless):
+	bool has_texcoords = false;
+};
+
+//vertex formats stored in mesh files:
+struct v3n3 {
+	glm::vec3 v;
+	glm::vec3 n;
+};
+static_assert(sizeof(v3n3) == 24, "v3n3 is packed");
+
+//per-vertex color (parallel to v3n3), kept in its own buffer:
+struct c4ub {
+	uint8_t r, g, b, a;
+};
+static_assert(sizeof(c4ub) == 4, "c4ub is packed");
+
+//per-vertex texture coordinate (parallel to v3n3), kept in its own buffer:
+struct t2f {
+	glm::vec2 t;
+};
+static_assert(sizeof(t2f) == 8, "t2f is packed");
+
+//CPU-side copy of one mesh's vertices, read but not yet uploaded:
+struct StagedMesh {
+	MeshID id = 0;
+	std::string name; //(for warnings)
+	std::vector< v3n3 > data; //full-detail mesh, then each level of detail in order
+	std::vector< c4ub > colors; //parallel to data
+	std::vector< t2f > texcoords; //parallel to data
+	GLuint count = 0; //vertices in full-detail mesh
+	uint32_t lod_count = 0;
+	GLuint lod_counts[Mesh::MaxLODs] = {0, 0, 0};
+	//bounding sphere, translucency, and texture coordinates (see Mesh):
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;
+	bool translucent = false;
+	bool has_texcoords = false;
+	//if not 0, this mesh uses the same vertices as mesh 'alias' (which must be added first),
+	// and data, colors, and texcoords are empty:
+	MeshID alias = 0;
+};
+
+//a staged mesh whose vertices have already been copied into buffers of their own
+// (e.g., by GLUploader's shared context); adding it to Meshes is then a GPU-side copy:
+struct UploadedMesh {
+	StagedMesh info; //(info.data, info.colors, and info.texcoords are left empty)
+	GLuint vertices = 0; //number of vertices (all levels) in the buffers
+	GLuint buffer = 0; //v3n3 data
+	GLuint color_buffer = 0; //c4ub data
+	GLuint texcoord_buffer = 0; //t2f data
+	//(for an alias, there are no vertices or buffers)
 };
 
 //"Meshes" loads a collection of meshes and builds VAOs for 'em
@@ -18,15 +88,115 @@ struct Meshes {
 		GLuint Position = -1U;
 		GLuint Normal = -1U;
 		GLuint Color = -1U;
+		GLuint TexCoord = -1U;
+	};
+	//when mesh vertex data is sent to the GPU:
+	enum UploadMode {
+		UploadAll, //everything in the file, during load()
+		UploadOnDemand, //each mesh, the first time get() is called with its name
 	};
 	//add meshes from a file; use the indicated indices for attribute locations:
 	// note: will throw if file fails to read.
-	void load(std::string const &filename, Attributes const &attributes);
+	void load(std::string const &filename, Attributes const &attributes, UploadMode mode = UploadAll);
 
 	//look up a particular mesh in the DB:
 	// note: will throw if mesh not found.
-	Mesh const &get(std::string const &name) const;
+	// note: may upload vertex data (meshes loaded with UploadOnDemand).
+	// note: returned reference is valid until the next call to load(), add_staged(), or add_uploaded().
+	Mesh const &get(MeshID id);
+	Mesh const &get(std::string const &name) { return get(mesh_id(name.data(), name.data() + name.size())); }
+
+	//look up a mesh without uploading anything; returns nullptr if it isn't on the GPU (yet):
+	Mesh const *find(MeshID id);
+
+	//reading mesh files without touching OpenGL (so safe to call from a loader thread):
+
+	//where one mesh's vertices are in a mesh file:
+	struct FileEntry {
+		MeshID id = 0;
+		std::string name;
+		GLuint vertex_start = 0; //within the file's v3n3 chunk
+		GLuint vertex_count = 0;
+		uint32_t lod_count = 0;
+		Mesh::LOD lods[Mesh::MaxLODs]; //(also within the file's v3n3 chunk)
+		//index of an earlier entry with exactly the same vertices (all levels), or -1U;
+		// such entries (e.g., many objects exported with one shared mesh) get drawn from one copy:
+		uint32_t same_as = -1U;
+	};
+	//a mesh file's (validated) index:
+	struct FileIndex {
+		std::string filename;
+		std::streamoff data_offset = 0; //offset of v3n3 chunk data in file
+		GLuint total = 0; //vertices in v3n3 chunk
+		bool has_colors = false;
+		ChunkInfo colors_chunk; //location of c4ub chunk (if has_colors)
+		bool has_texcoords = false;
+		ChunkInfo texcoords_chunk; //location of t2f0 chunk (if has_texcoords)
+		bool trailing = false; //file had data after its last chunk
+		std::vector< FileEntry > entries;
+	};
+	//read the index of a mesh file:
+	// note: will throw if the file fails to read or is inconsistent.
+	static void read_index(std::istream &file, std::string const &filename, FileIndex *index);
+	//read one entry's vertices (all levels) from an open mesh file:
+	static void read_staged(std::istream &file, FileIndex const &index, FileEntry const &entry, StagedMesh *staged);
+
+	//add (and upload) a mesh read with read_staged (or an alias, which uploads nothing):
+	// note: warns and ignores the mesh if its id is already in use (or an alias's mesh isn't there).
+	void add_staged(StagedMesh const &staged, Attributes const &attributes);
+	//add a mesh from buffers filled elsewhere; 'uploaded's buffers are deleted afterward:
+	// note: the buffers must be finished being written (e.g., their fence has signaled).
+	void add_uploaded(UploadedMesh const &uploaded, Attributes const &attributes);
 
 	//internals:
-	std::map< std::string, Mesh > meshes;
+
+	//open-addressing (linear probing) hash table of meshes:
+	struct Slot {
+		MeshID id = 0; //0 marks an empty slot
+		Mesh mesh;
+		uint32_t pending = -1U; //index into 'pending' if not uploaded yet
+	};
+	std::vector< Slot > slots; //size is zero or a power of two
+	uint32_t slots_used = 0;
+
+	//find slot for id (either holding id or the empty slot where it would go):
+	Slot &find_slot(MeshID id);
+	//grow (and rehash) table so 'count' more meshes keep load factor at most 1/2:
+	void reserve_slots(size_t count);
+
+	//files loaded with UploadOnDemand:
+	struct Source {
+		FileIndex index;
+		GLuint vao = 0;
+	};
+	std::vector< Source > sources;
+
+	//meshes that were loaded with UploadOnDemand:
+	struct Pending {
+		uint32_t source = 0; //index into sources
+		uint32_t entry = 0; //index into that source's index.entries
+	};
+	std::vector< Pending > pending;
+
+	//every load() appends vertices to one shared arena, so meshes from different files
+	// (and with the same Attributes) can be drawn without switching VAOs:
+	struct {
+		GLuint buffer = 0; //v3n3 data
+		GLuint color_buffer = 0; //c4ub data
+		GLuint texcoord_buffer = 0; //t2f data
+		GLuint capacity = 0; //in vertices
+		GLuint used = 0; //in vertices
+		std::vector< std::pair< Attributes, GLuint > > vaos; //one per vertex format; re-pointed when buffers are reallocated
+	} arena;
+
+	//get (or make) the arena VAO for a set of attribute locations:
+	GLuint vao_for(Attributes const &attributes);
+	//make room for 'count' more vertices in the arena (growing buffers and re-pointing VAOs if needed):
+	void reserve_arena(GLuint count);
+	//copy 'count' v3n3 vertices, c4ub colors, and t2f texcoords to the end of the arena; returns index of first vertex:
+	GLuint append(void const *data, void const *colors, void const *texcoords, GLuint count);
+	//point 'mesh' at a staged mesh's vertices, which start at arena vertex 'start':
+	static void point_mesh(StagedMesh const &staged, GLuint vao, GLuint start, Mesh *mesh);
+	//add 'id' as another name for the (already added) mesh 'alias'; returns false (after warning) if it can't be:
+	bool add_alias(MeshID id, std::string const &name, MeshID alias);
 };
@@ -1,9 +1,14 @@
 #include "Scene.hpp"
+#include "FrameTimers.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include <iostream>
+#include <algorithm>
+#include <tuple>
+#include <cassert>
+#include <cmath>
 
 glm::mat4 Scene::Transform::make_local_to_parent() const {
 	return glm::mat4( //translate
@@ -109,7 +114,8 @@ glm::mat4 Scene::Camera::make_projection() const {
 
 void Scene::render() {
 	glm::mat4 world_to_camera = camera.transform.make_world_to_local();
-	glm::mat4 world_to_clip = camera.make_projection() * world_to_camera;
+	glm::mat4 camera_to_clip = camera.make_projection();
+	projection = camera_to_clip;
 
 	//Get world-space position of all lights:
 	for (auto const &light : lights) {
@@ -117,30 +123,192 @@ void Scene::render() {
 		(void)mv;
 	}
 
-	for (auto const &object : objects) {
-		glm::mat4 local_to_world = object.transform.make_local_to_world();
+	//objects step to level of detail l+1 when their bounding sphere's projected radius drops
+	// below LODThreshold / 2^l of the viewport's half-height; the LODHysteresis band around
+	// each threshold keeps objects near one from switching levels every frame:
+	float const LODThreshold = 0.25f;
+	float const LODHysteresis = 0.1f;
+	float const screen_scale = 1.0f / std::tan(0.5f * camera.fovy);
 
-		//compute modelview+projection (object space to clip space) matrix for this object:
-		glm::mat4 mvp = world_to_clip * local_to_world;
+	//sort objects into passes by material (and whether they're instanced):
+	instanced_draws.clear();
+	opaque_draws.clear();
+	transparent_draws.clear();
+	for (auto &object : objects) {
+		if (object.count == 0) continue; //(mesh not uploaded yet)
+		Draw draw;
+		draw.object = &object;
+		draw.mv = world_to_camera * object.transform.make_local_to_world();
+		draw.mvp = camera_to_clip * draw.mv;
+		draw.depth = -(draw.mv * glm::vec4(object.center, 1.0f)).z;
 
-		//compute modelview (object space to camera local space) matrix for this object:
-		glm::mat4 mv = world_to_camera * local_to_world;
+		//pick level of detail (once per frame, so every pass draws the same vertices):
+		draw.start = object.start;
+		draw.count = object.count;
+		if (object.lod_count) {
+			glm::mat4 const &mv = draw.mv;
+			float scale = std::max(glm::length(glm::vec3(mv[0])), std::max(glm::length(glm::vec3(mv[1])), glm::length(glm::vec3(mv[2]))));
+			float size = scale * object.radius * screen_scale / std::max(camera.near, draw.depth);
+			if (object.lod > object.lod_count) object.lod = object.lod_count;
+			while (object.lod < object.lod_count && size < LODThreshold / float(1 << object.lod) * (1.0f - LODHysteresis)) {
+				object.lod += 1;
+			}
+			while (object.lod > 0 && size > LODThreshold / float(1 << (object.lod - 1)) * (1.0f + LODHysteresis)) {
+				object.lod -= 1;
+			}
+			if (object.lod > 0) {
+				draw.start = object.lods[object.lod - 1].start;
+				draw.count = object.lods[object.lod - 1].count;
+			}
+		}
 
-		//NOTE: inverse cancels out transpose unless there is scale involved
-		glm::mat3 itmv = glm::inverse(glm::transpose(glm::mat3(mv)));
+		if (object.material & Object::Transparent) transparent_draws.emplace_back(draw);
+		else if (object.program_projection != -1U) instanced_draws.emplace_back(draw);
+		else opaque_draws.emplace_back(draw);
+	}
 
-		//set up program uniforms:
-		glUseProgram(object.program);
-		if (object.program_mvp != -1U) {
-			glUniformMatrix4fv(object.program_mvp, 1, GL_FALSE, glm::value_ptr(mvp));
+	//objects usually share a program and (thanks to the Meshes arena) a VAO, so only bind on change:
+	Bound bound;
+
+	glDisable(GL_BLEND);
+
+	//instanced pass: one draw for each run of objects with the same program, texture, and vertices;
+	// (their vertices are transformed on the GPU, so they can't be in the depth pre-pass -- which wouldn't
+	//  compute exactly the same depths -- and are drawn first, with the usual depth test, instead)
+	if (!instanced_draws.empty()) {
+		FrameTimers::Scope pass(timers, "instanced");
+		auto key = [](Draw const &draw) {
+			return std::make_tuple(draw.object->program, draw.object->texture, draw.object->vao, draw.start, draw.count);
+		};
+		std::stable_sort(instanced_draws.begin(), instanced_draws.end(), [&key](Draw const &a, Draw const &b) {
+			return key(a) < key(b);
+		});
+		for (uint32_t begin = 0; begin < instanced_draws.size(); ) {
+			uint32_t end = begin + 1;
+			while (end < instanced_draws.size() && end - begin < MaxInstances && key(instanced_draws[end]) == key(instanced_draws[begin])) {
+				end += 1;
+			}
+			draw_instanced(&instanced_draws[begin], end - begin, &bound);
+			begin = end;
+		}
+	}
+
+	//opaque pass: near objects first, so depth testing can reject hidden fragments before shading them:
+	std::stable_sort(opaque_draws.begin(), opaque_draws.end(), [](Draw const &a, Draw const &b) {
+		return a.depth < b.depth;
+	});
+	bool prepass = (depth_prepass && depth_program != 0 && !opaque_draws.empty());
+	if (prepass) {
+		FrameTimers::Scope pass(timers, "depth pre-pass");
+		//depth only:
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		glUseProgram(depth_program);
+		bound.program = depth_program;
+		for (auto const &draw : opaque_draws) {
+			if (draw.object->vao != bound.vao) {
+				glBindVertexArray(draw.object->vao);
+				bound.vao = draw.object->vao;
+			}
+			glUniformMatrix4fv(depth_program_mvp, 1, GL_FALSE, glm::value_ptr(draw.mvp));
+			glDrawArrays(GL_TRIANGLES, draw.start, draw.count);
 		}
-		if (object.program_itmv != -1U) {
-			glUniformMatrix3fv(object.program_itmv, 1, GL_FALSE, glm::value_ptr(itmv));
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		//then shade only the fragments that ended up in front:
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+	}
+	if (!opaque_draws.empty()) {
+		FrameTimers::Scope pass(timers, "opaque");
+		for (auto const &draw : opaque_draws) {
+			this->draw(draw, &bound);
 		}
+	}
+	if (prepass) {
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+	}
 
+	//transparent pass: far objects first, so each blends over what's behind it;
+	// depth is tested (against opaque objects) but not written:
+	if (!transparent_draws.empty()) {
+		std::stable_sort(transparent_draws.begin(), transparent_draws.end(), [](Draw const &a, Draw const &b) {
+			return a.depth > b.depth;
+		});
+		FrameTimers::Scope pass(timers, "transparent");
+		glEnable(GL_BLEND);
+		//(alpha is blended "over" as well, so an opaque background stays opaque)
+		glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		glDepthMask(GL_FALSE);
+		for (auto const &draw : transparent_draws) {
+			this->draw(draw, &bound);
+		}
+		glDepthMask(GL_TRUE);
+		glDisable(GL_BLEND);
+	}
+}
+
+void Scene::bind(Object const &object, Bound *bound) {
+	if (object.program != bound->program) {
+		glUseProgram(object.program);
+		bound->program = object.program;
+	}
+	if (object.vao != bound->vao) {
 		glBindVertexArray(object.vao);
+		bound->vao = object.vao;
+	}
+	if (object.texture && object.texture != bound->texture) {
+		glBindTexture(GL_TEXTURE_2D_ARRAY, object.texture); //(unit 0 stays active)
+		bound->texture = object.texture;
+	}
+}
+
+void Scene::draw(Draw const &draw, Bound *bound) {
+	Object const &object = *draw.object;
+	glm::mat4 const &mv = draw.mv;
+
+	if (object.program_projection != -1U) { //(e.g., a transparent object with an instanced program)
+		draw_instanced(&draw, 1, bound);
+		return;
+	}
+	bind(object, bound);
+
+	//set up program uniforms:
+	if (object.program_mvp != -1U) {
+		glUniformMatrix4fv(object.program_mvp, 1, GL_FALSE, glm::value_ptr(draw.mvp));
+	}
+	if (object.program_mv != -1U) {
+		glUniformMatrix4fv(object.program_mv, 1, GL_FALSE, glm::value_ptr(mv));
+	}
+	if (object.program_itmv != -1U) { //(uniform-scale variants don't need this, so skip the inverse)
+		//NOTE: inverse cancels out transpose unless there is scale involved
+		glm::mat3 itmv = glm::inverse(glm::transpose(glm::mat3(mv)));
+		glUniformMatrix3fv(object.program_itmv, 1, GL_FALSE, glm::value_ptr(itmv));
+	}
+	if (object.program_layer != -1U) {
+		glUniform1f(object.program_layer, float(object.layer));
+	}
 
-		//draw the object:
-		glDrawArrays(GL_TRIANGLES, object.start, object.count);
+	//draw the object:
+	glDrawArrays(GL_TRIANGLES, draw.start, draw.count);
+}
+
+void Scene::draw_instanced(Draw const *draws, uint32_t count, Bound *bound) {
+	assert(count > 0 && count <= MaxInstances);
+	Object const &object = *draws[0].object;
+	bind(object, bound);
+	glUniformMatrix4fv(object.program_projection, 1, GL_FALSE, glm::value_ptr(projection));
+
+	instances.resize(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		instances[i].mv = draws[i].mv;
+		instances[i].layer = glm::vec4(float(draws[i].object->layer), 0.0f, 0.0f, 0.0f);
 	}
+	if (instance_buffer == 0) glGenBuffers(1, &instance_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, instance_buffer);
+	//(orphan the last batch's data, so writing this batch doesn't wait for it to be drawn)
+	glBufferData(GL_UNIFORM_BUFFER, MaxInstances * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, count * sizeof(Instance), instances.data());
+	glBindBufferBase(GL_UNIFORM_BUFFER, InstancesBinding, instance_buffer);
+
+	glDrawArraysInstanced(GL_TRIANGLES, draws[0].start, draws[0].count, count);
 }
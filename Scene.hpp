@@ -8,6 +8,8 @@
 
 #undef near //windows.h steps on this
 
+struct FrameTimers;
+
 //Describes a 3D scene for rendering:
 struct Scene {
 	struct Transform {
@@ -63,10 +65,33 @@ struct Scene {
 		GLuint vao = 0;
 		GLuint start = 0;
 		GLuint count = 0;
+		//coarser levels of detail (copied from Mesh) and the bounding sphere used to pick one:
+		struct LOD {
+			GLuint start = 0;
+			GLuint count = 0;
+		};
+		enum { MaxLODs = 3 };
+		uint32_t lod_count = 0;
+		LOD lods[MaxLODs];
+		glm::vec3 center = glm::vec3(0.0f); //(object space)
+		float radius = 0.0f;
+		uint32_t lod = 0; //level drawn last frame (0 is full detail); updated by render()
+		//material flags (pick the pass the object is drawn in):
+		enum Material : uint32_t {
+			Transparent = 0x1, //blended over what's behind it (drawn after everything opaque, back-to-front)
+		};
+		uint32_t material = 0;
+		//texture info (if the program samples one):
+		GLuint texture = 0; //GL_TEXTURE_2D_ARRAY, bound to unit 0 while drawing
+		uint32_t layer = 0; //layer of 'texture' the object uses
 		//program info:
 		GLuint program = 0;
 		GLuint program_mvp = -1U; //uniform index for MVP matrix
-		GLuint program_itmv = -1U; //uniform index for inverse(transpose(mv)) matrix
+		GLuint program_mv = -1U; //uniform index for MV matrix (if the program uses it)
+		GLuint program_itmv = -1U; //uniform index for inverse(transpose(mv)) matrix (if the program uses it)
+		GLuint program_layer = -1U; //uniform index for texture layer (if the program uses it)
+		//instanced programs take the projection as a uniform and mv + layer per instance (see Instance):
+		GLuint program_projection = -1U; //uniform index for projection matrix (set only for instanced programs)
 	};
 	struct Light {
 		Transform transform;
@@ -78,5 +103,54 @@ struct Scene {
 	std::list< Object > objects;
 	std::list< Light > lights;
 
+	//optional depth-only pre-pass: opaque objects are first drawn with 'depth_program' (which
+	// must compute gl_Position exactly as the objects' programs do -- e.g., both declare it
+	// 'invariant') to fill the depth buffer, then shaded with a GL_EQUAL depth test, so each
+	// pixel runs the full fragment shader once. Worth it when fragment shading is expensive:
+	bool depth_prepass = false;
+	GLuint depth_program = 0;
+	GLuint depth_program_mvp = -1U; //uniform index for MVP matrix
+
+	//objects with instanced programs that share a program, texture, and vertices (e.g., pool balls,
+	// which differ only in their texture layer) are drawn with one glDrawArraysInstanced; each
+	// instance's data comes from the program's 'Instances' uniform block, MaxInstances at a time:
+	enum {
+		MaxInstances = 64,
+		InstancesBinding = 0, //uniform buffer binding point of the 'Instances' block
+	};
+	struct Instance { //(std140: "struct Instance { mat4 mv; vec4 layer; };")
+		glm::mat4 mv;
+		glm::vec4 layer; //(layer in x)
+	};
+	static_assert(sizeof(Instance) == 80, "Instance matches its std140 layout");
+
+	//if set, render() times each of its passes as a FrameTimers scope:
+	FrameTimers *timers = nullptr;
+
+	//draws instanced opaque objects, then other opaque objects (front-to-back, no blending), then transparent ones (back-to-front, blended):
+	// note: leaves blending disabled, depth writes enabled, and the depth test at GL_LESS.
 	void render();
+
+	//internals:
+	struct Draw {
+		Object *object;
+		glm::mat4 mv; //object space to camera space
+		glm::mat4 mvp; //object space to clip space
+		float depth; //distance in front of the camera of the object's bounding sphere center
+		GLuint start, count; //vertices of the level of detail to draw
+	};
+	std::vector< Draw > instanced_draws, opaque_draws, transparent_draws; //(rebuilt by every render(); kept to reuse their memory)
+	glm::mat4 projection; //(this render()'s, for instanced programs)
+	std::vector< Instance > instances; //(staging for instance_buffer)
+	GLuint instance_buffer = 0; //(made on first use)
+	//GL state, so it's only changed when it needs to be:
+	struct Bound {
+		GLuint program = 0;
+		GLuint vao = 0;
+		GLuint texture = 0;
+	};
+	void bind(Object const &object, Bound *bound);
+	void draw(Draw const &draw, Bound *bound);
+	//draw 'count' draws (with the same object program, texture, and vertices) as instances:
+	void draw_instanced(Draw const *draws, uint32_t count, Bound *bound);
 };
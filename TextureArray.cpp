@@ -0,0 +1,159 @@
+#include "TextureArray.hpp"
+#include "load_save_png.hpp"
+#include "read_chunk.hpp"
+
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cassert>
+
+//native layout -> GL formats:
+static void gl_formats(uint32_t channels, uint32_t bit_depth, GLenum *internal_format, GLenum *format, GLenum *type) {
+	static GLenum const formats[4] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+	static GLenum const formats8[4] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+	static GLenum const formats16[4] = {GL_R16, GL_RG16, GL_RGB16, GL_RGBA16};
+	assert(channels >= 1 && channels <= 4);
+	*format = formats[channels - 1];
+	*internal_format = (bit_depth == 16 ? formats16 : formats8)[channels - 1];
+	*type = (bit_depth == 16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE);
+}
+
+//sampling parameters for the bound GL_TEXTURE_2D_ARRAY:
+static void set_parameters(uint32_t channels, bool wrap_s, bool wrap_t) {
+	if (channels == 1) {
+		GLint const gray[4] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+		glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, gray);
+	} else if (channels == 2) {
+		GLint const gray_alpha[4] = {GL_RED, GL_RED, GL_RED, GL_GREEN};
+		glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, gray_alpha);
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap_s ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap_t ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+}
+
+TextureArray::TextureArray(std::string const &blob, std::string const &name) {
+	std::ifstream file(blob, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Failed to open texture blob '" + blob + "'.");
+	}
+	std::vector< ChunkInfo > toc = index_chunks(file);
+	ChunkInfo const *str0 = find_chunk(toc, "str0");
+	ChunkInfo const *tex0 = find_chunk(toc, "tex0");
+	ChunkInfo const *mip0 = find_chunk(toc, "mip0");
+	if (!str0 || !tex0 || !mip0) {
+		throw std::runtime_error("Texture blob '" + blob + "' is missing a str0, tex0, or mip0 chunk.");
+	}
+	std::vector< char > strings;
+	std::vector< BlobEntry > entries;
+	read_chunk(file, *str0, &strings);
+	read_chunk(file, *tex0, &entries);
+
+	BlobEntry const *entry = nullptr;
+	for (auto const &e : entries) {
+		if (e.name_begin <= e.name_end && e.name_end <= strings.size()
+		 && std::string(strings.begin() + e.name_begin, strings.begin() + e.name_end) == name) {
+			entry = &e;
+			break;
+		}
+	}
+	if (!entry) {
+		throw std::runtime_error("Texture blob '" + blob + "' has no texture named '" + name + "'.");
+	}
+
+	//check that the levels fit in their data:
+	if (entry->channels < 1 || entry->channels > 4 || (entry->bit_depth != 8 && entry->bit_depth != 16)
+	 || entry->width == 0 || entry->height == 0 || entry->layers == 0
+	 || entry->levels == 0 || entry->levels > 32 || (std::max(entry->width, entry->height) >> (entry->levels - 1)) == 0) {
+		throw std::runtime_error("Texture '" + name + "' in '" + blob + "' has an unsupported layout.");
+	}
+	size_t pixel_bytes = entry->channels * (entry->bit_depth / 8);
+	size_t expected = 0;
+	for (uint32_t level = 0; level < entry->levels; ++level) {
+		expected += size_t(std::max(1U, entry->width >> level)) * std::max(1U, entry->height >> level) * entry->layers * pixel_bytes;
+	}
+	if (entry->data_begin > entry->data_end || entry->data_end > mip0->size || entry->data_end - entry->data_begin != expected) {
+		throw std::runtime_error("Texture '" + name + "' in '" + blob + "' doesn't match its data.");
+	}
+
+	//read just this texture's texels:
+	std::vector< uint8_t > data(expected);
+	file.seekg(mip0->offset + entry->data_begin, std::ios::beg);
+	if (!file.read(reinterpret_cast< char * >(data.data()), data.size())) {
+		throw std::runtime_error("Failed to read texture '" + name + "' from '" + blob + "'.");
+	}
+
+	GLenum internal_format, format, type;
+	gl_formats(entry->channels, entry->bit_depth, &internal_format, &format, &type);
+
+	size = glm::uvec2(entry->width, entry->height);
+	layers = entry->layers;
+	levels = entry->levels;
+
+	//each level's layers are contiguous, so each level is one upload:
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); //(rows are tightly packed)
+	uint8_t const *at = data.data();
+	for (uint32_t level = 0; level < levels; ++level) {
+		glm::uvec2 level_size(std::max(1U, size.x >> level), std::max(1U, size.y >> level));
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internal_format, level_size.x, level_size.y, layers, 0, format, type, at);
+		at += size_t(level_size.x) * level_size.y * layers * pixel_bytes;
+	}
+	assert(at == data.data() + data.size());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+	set_parameters(entry->channels, (entry->flags & WrapSFlag) != 0, (entry->flags & WrapTFlag) != 0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+TextureArray::TextureArray(std::vector< std::string > const &filenames) {
+	if (filenames.empty()) {
+		throw std::runtime_error("Texture array needs at least one layer.");
+	}
+	std::vector< PNGSource > sources;
+	for (auto const &filename : filenames) {
+		sources.emplace_back(filename);
+	}
+	//(bottom row first, so texture coordinates have t = 0 at the bottom, as exported from blender)
+	std::vector< LoadedPNG > images = load_pngs(sources, LowerLeftOrigin);
+
+	PNGLayout const &layout = images[0].layout;
+	for (uint32_t i = 0; i < images.size(); ++i) {
+		if (!images[i].loaded) {
+			throw std::runtime_error("Failed to load texture array layer '" + filenames[i] + "'.");
+		}
+		PNGLayout const &other = images[i].layout;
+		if (other.width != layout.width || other.height != layout.height || other.channels != layout.channels || other.bit_depth != layout.bit_depth) {
+			throw std::runtime_error("Texture array layer '" + filenames[i] + "' doesn't match the size and layout of '" + filenames[0] + "'.");
+		}
+	}
+
+	GLenum internal_format, format, type;
+	gl_formats(layout.channels, layout.bit_depth, &internal_format, &format, &type);
+
+	size = glm::uvec2(layout.width, layout.height);
+	layers = images.size();
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internal_format, size.x, size.y, layers, 0, format, type, nullptr);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); //(rows are tightly packed, and RGB rows needn't be a multiple of 4 bytes)
+	for (uint32_t i = 0; i < layers; ++i) {
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, size.x, size.y, 1, format, type, images[i].pixels.data());
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	levels = 1;
+	for (uint32_t s = std::max(size.x, size.y); s > 1; s >>= 1) levels += 1;
+
+	set_parameters(layout.channels, true, false);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+TextureArray::~TextureArray() {
+	glDeleteTextures(1, &texture);
+}
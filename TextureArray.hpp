@@ -0,0 +1,52 @@
+#pragma once
+
+#include "GL.hpp"
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+//"TextureArray" is a GL_TEXTURE_2D_ARRAY with one layer per PNG (e.g., the faces of the pool
+// balls), so objects that differ only in their texture can share a mesh -- and a draw call,
+// picking their layer per instance (see Scene::Object::layer):
+// - textures from a blob made by compile_textures come with every mip level, made offline
+//   (gamma-correct, and the same on every driver), and are uploaded as-is, level by level;
+// - PNGs are decoded in parallel (load_pngs) and get mipmaps from glGenerateMipmap;
+// - either way, texels keep their PNG layout, and one- and two-channel images are swizzled
+//   to read as gray (and gray + alpha) in shaders;
+// - layers get trilinear filtering; PNGs repeat in s (around a sphere) but not t, and
+//   compiled textures as compile_textures was told (-w).
+struct TextureArray {
+	//load texture 'name' from a compile_textures blob:
+	//note: throws if the blob can't be read, or has no texture called 'name'.
+	TextureArray(std::string const &blob, std::string const &name);
+	//load (and mipmap) one layer per PNG:
+	//note: throws if a file fails to load, or the files differ in size or layout.
+	TextureArray(std::vector< std::string > const &filenames);
+	~TextureArray();
+	TextureArray(TextureArray const &) = delete;
+	TextureArray &operator=(TextureArray const &) = delete;
+
+	GLuint texture = 0;
+	glm::uvec2 size = glm::uvec2(0);
+	uint32_t layers = 0;
+	uint32_t levels = 0;
+
+	//"tex0" entries in compile_textures blobs (see compile_textures.cpp for the format):
+	struct BlobEntry {
+		uint32_t name_begin, name_end; //in str0
+		uint32_t width, height; //of level 0
+		uint32_t layers;
+		uint32_t channels; //1-4 (as in PNGLayout; 2 is gray + alpha)
+		uint32_t bit_depth; //8 or 16 (native byte order)
+		uint32_t levels; //down to 1x1
+		uint32_t flags; //see below
+		uint32_t data_begin, data_end; //in mip0
+	};
+	static_assert(sizeof(BlobEntry) == 44, "BlobEntry is packed");
+	enum BlobFlags : uint32_t {
+		LinearFlag = 0x1, //not sRGB-encoded (doesn't change how it's sampled)
+		WrapSFlag = 0x2, //repeats in s
+		WrapTFlag = 0x4, //repeats in t
+	};
+};
@@ -0,0 +1,209 @@
+//compile_textures: build textures.blob -- textures with every mip level made ahead of time -- from PNGs.
+//
+// usage:
+//   compile_textures [-j threads] [-o textures.blob] [-f box|kaiser] [-w none|s|t|st] [-linear] name=file.png [name=file.png ...]
+//
+// Each 'name=file.png' adds file.png as the next layer of texture 'name', so
+// (in bash) 'ball-faces=textures/ball-{1..15}.png' makes a 15-layer array.
+// A texture's layers must share a size and PNG layout (channels and bit depth),
+// which is kept as-is. Options apply to the textures first named after them:
+//   -f  mip filter (default kaiser; see MipOptions)
+//   -w  which texture coordinates repeat (default none); filters wrap around
+//       those edges, and the game sets GL_REPEAT for them
+//   -linear  texels aren't sRGB-encoded (e.g., normal maps)
+//
+// textures.blob is three chunks (see read_chunk.hpp), read by TextureArray:
+//   "str0": texture names (not zero-terminated)
+//   "tex0": one TextureEntry per texture
+//   "mip0": texels; each texture's are its levels, largest first, each level
+//           holding every layer in turn, each layer's rows bottom first and
+//           tightly packed -- i.e., what glTexImage3D takes for the level.
+//
+// models/make-ball-textures.py shows how the pool ball faces are compiled.
+
+#include "load_save_png.hpp"
+#include "mipmaps.hpp"
+#include "parallel_for.hpp"
+#include "read_chunk.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+
+//(same layout as TextureArray::BlobEntry)
+struct TextureEntry {
+	uint32_t name_begin, name_end; //in str0
+	uint32_t width, height; //of level 0
+	uint32_t layers;
+	uint32_t channels; //1-4 (as in PNGLayout; 2 is gray + alpha)
+	uint32_t bit_depth; //8 or 16 (native byte order)
+	uint32_t levels; //down to 1x1
+	uint32_t flags; //TextureFlags
+	uint32_t data_begin, data_end; //in mip0
+};
+static_assert(sizeof(TextureEntry) == 44, "TextureEntry is packed");
+
+enum TextureFlags : uint32_t {
+	LinearFlag = 0x1, //not sRGB-encoded
+	WrapSFlag = 0x2, //repeats in s
+	WrapTFlag = 0x4, //repeats in t
+};
+
+//a texture being compiled:
+struct Texture {
+	std::string name;
+	std::vector< std::string > files; //one per layer
+	MipOptions options;
+	uint32_t flags = 0;
+};
+
+int main(int argc, char **argv) {
+	uint32_t threads = 0;
+	std::string out = "textures.blob";
+	MipOptions options;
+	uint32_t flags = 0;
+	std::vector< Texture > textures;
+	auto usage = [&]() {
+		std::cerr << "Usage:\n\t" << argv[0] << " [-j threads] [-o textures.blob] [-f box|kaiser] [-w none|s|t|st] [-linear] name=file.png [name=file.png ...]" << std::endl;
+		return 1;
+	};
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "-j" && i + 1 < argc) {
+			threads = std::atoi(argv[++i]);
+		} else if (arg == "-o" && i + 1 < argc) {
+			out = argv[++i];
+		} else if (arg == "-f" && i + 1 < argc) {
+			std::string filter = argv[++i];
+			if (filter == "box") options.filter = MipOptions::Box;
+			else if (filter == "kaiser") options.filter = MipOptions::Kaiser;
+			else return usage();
+		} else if (arg == "-w" && i + 1 < argc) {
+			std::string wrap = argv[++i];
+			if (wrap != "none" && wrap != "s" && wrap != "t" && wrap != "st") return usage();
+			options.wrap_x = (wrap.find('s') != std::string::npos);
+			options.wrap_y = (wrap.find('t') != std::string::npos);
+			flags = (flags & LinearFlag) | (options.wrap_x ? WrapSFlag : 0) | (options.wrap_y ? WrapTFlag : 0);
+		} else if (arg == "-linear") {
+			options.srgb = false;
+			flags |= LinearFlag;
+		} else if (!arg.empty() && arg[0] == '-') {
+			return usage();
+		} else {
+			size_t equals = arg.find('=');
+			if (equals == std::string::npos || equals == 0 || equals + 1 == arg.size()) return usage();
+			std::string name = arg.substr(0, equals);
+			Texture *texture = nullptr;
+			for (auto &t : textures) {
+				if (t.name == name) texture = &t;
+			}
+			if (!texture) {
+				textures.emplace_back();
+				texture = &textures.back();
+				texture->name = name;
+				texture->options = options;
+				texture->flags = flags;
+			}
+			texture->files.emplace_back(arg.substr(equals + 1));
+		}
+	}
+	if (textures.empty()) return usage();
+
+	try {
+		auto before = std::chrono::high_resolution_clock::now();
+
+		//decode every layer of every texture at once:
+		// (bottom row first, as glTexImage3D wants, and as TextureArray loads PNGs)
+		std::vector< PNGSource > sources;
+		for (auto const &texture : textures) {
+			for (auto const &file : texture.files) {
+				sources.emplace_back(file);
+			}
+		}
+		std::vector< LoadedPNG > images = load_pngs(sources, LowerLeftOrigin, threads);
+
+		//check layers match, and note which texture each image belongs to:
+		std::vector< uint32_t > texture_of;
+		{
+			uint32_t i = 0;
+			for (uint32_t t = 0; t < textures.size(); ++t) {
+				PNGLayout const &first = images[i].layout;
+				for (auto const &file : textures[t].files) {
+					if (!images[i].loaded) {
+						throw std::runtime_error("Failed to load '" + file + "'.");
+					}
+					PNGLayout const &layout = images[i].layout;
+					if (layout.width != first.width || layout.height != first.height || layout.channels != first.channels || layout.bit_depth != first.bit_depth) {
+						throw std::runtime_error("Layer '" + file + "' of '" + textures[t].name + "' doesn't match the size and layout of its first layer.");
+					}
+					texture_of.emplace_back(t);
+					++i;
+				}
+			}
+		}
+
+		//mip chains for every layer:
+		std::vector< std::vector< std::vector< uint8_t > > > chains(images.size());
+		parallel_for(images.size(), [&](uint32_t i) {
+			PNGLayout const &layout = images[i].layout;
+			chains[i] = make_mipmaps(layout.width, layout.height, layout.channels, layout.bit_depth, images[i].pixels, textures[texture_of[i]].options);
+			images[i].pixels = std::vector< uint8_t >(); //(no longer needed)
+		}, threads);
+
+		//lay out the chunks:
+		std::vector< char > strings;
+		std::vector< TextureEntry > entries;
+		std::vector< uint8_t > data;
+		uint32_t i = 0;
+		for (auto const &texture : textures) {
+			PNGLayout const &layout = images[i].layout;
+			TextureEntry entry;
+			entry.name_begin = strings.size();
+			strings.insert(strings.end(), texture.name.begin(), texture.name.end());
+			entry.name_end = strings.size();
+			entry.width = layout.width;
+			entry.height = layout.height;
+			entry.layers = texture.files.size();
+			entry.channels = layout.channels;
+			entry.bit_depth = layout.bit_depth;
+			entry.levels = mip_levels(layout.width, layout.height);
+			entry.flags = texture.flags;
+			entry.data_begin = data.size();
+			for (uint32_t level = 0; level < entry.levels; ++level) {
+				for (uint32_t layer = 0; layer < entry.layers; ++layer) {
+					std::vector< uint8_t > const &pixels = chains[i + layer][level];
+					data.insert(data.end(), pixels.begin(), pixels.end());
+				}
+			}
+			entry.data_end = data.size();
+			entries.emplace_back(entry);
+			std::cout << "  " << texture.name << ": " << entry.width << "x" << entry.height << ", " << entry.layers << " layer(s), " << entry.levels << " levels, " << (entry.data_end - entry.data_begin) / 1024 << "kB." << std::endl;
+			i += entry.layers;
+		}
+
+		std::ofstream file(out, std::ios::binary);
+		auto write_chunk = [&](char const *magic, void const *bytes, size_t size) {
+			ChunkHeader header;
+			std::memcpy(header.magic, magic, 4);
+			header.size = uint32_t(size);
+			file.write(reinterpret_cast< char const * >(&header), sizeof(header));
+			file.write(reinterpret_cast< char const * >(bytes), size);
+		};
+		write_chunk("str0", strings.data(), strings.size());
+		write_chunk("tex0", entries.data(), entries.size() * sizeof(TextureEntry));
+		write_chunk("mip0", data.data(), data.size());
+		if (!file) throw std::runtime_error("Failed to write '" + out + "'.");
+
+		auto after = std::chrono::high_resolution_clock::now();
+		std::cout << "Compiled " << textures.size() << " texture(s) to '" << out << "' in " << std::chrono::duration< double >(after - before).count() << " seconds." << std::endl;
+	} catch (std::exception &e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
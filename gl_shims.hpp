@@ -319,6 +319,7 @@ DO(GENERATEMIPMAP, GenerateMipmap)
 DO(BLITFRAMEBUFFER, BlitFramebuffer)
 DO(RENDERBUFFERSTORAGEMULTISAMPLE, RenderbufferStorageMultisample)
 DO(FRAMEBUFFERTEXTURELAYER, FramebufferTextureLayer)
+DO(MAPBUFFERRANGE, MapBufferRange)
 DO(FLUSHMAPPEDBUFFERRANGE, FlushMappedBufferRange)
 DO(BINDVERTEXARRAY, BindVertexArray)
 DO(DELETEVERTEXARRAYS, DeleteVertexArrays)
@@ -359,5 +360,9 @@ DO(TEXIMAGE2DMULTISAMPLE, TexImage2DMultisample)
 DO(TEXIMAGE3DMULTISAMPLE, TexImage3DMultisample)
 DO(GETMULTISAMPLEFV, GetMultisamplefv)
 DO(SAMPLEMASKI, SampleMaski)
+// GL_VERSION_3_3 extensions (just timer queries, for FrameTimers):
+DO(QUERYCOUNTER, QueryCounter)
+DO(GETQUERYOBJECTI64V, GetQueryObjecti64v)
+DO(GETQUERYOBJECTUI64V, GetQueryObjectui64v)
 
 #endif //GL_SHIMS_HPP
@@ -0,0 +1,152 @@
+#include "headless.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+//(not in older eglext.h headers)
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+//is 'name' in a space-separated extension list?
+static bool has_extension(char const *extensions, char const *name) {
+	if (!extensions) return false;
+	size_t length = std::strlen(name);
+	for (char const *at = extensions; (at = std::strstr(at, name)); at += length) {
+		if ((at == extensions || at[-1] == ' ') && (at[length] == ' ' || at[length] == '\0')) return true;
+	}
+	return false;
+}
+
+HeadlessGL::HeadlessGL() {
+	EGLDisplay egl_display = EGL_NO_DISPLAY;
+
+	//the surfaceless platform doesn't need a display server at all:
+	char const *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS); //(null if client extensions aren't supported)
+	if (has_extension(client_extensions, "EGL_MESA_platform_surfaceless") && has_extension(client_extensions, "EGL_EXT_platform_base")) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC GetPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (GetPlatformDisplay) {
+			egl_display = GetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		}
+	}
+	if (egl_display == EGL_NO_DISPLAY) {
+		egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	EGLint major = 0, minor = 0;
+	if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, &major, &minor)) {
+		throw std::runtime_error("Failed to initialize an EGL display.");
+	}
+	display = egl_display;
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		throw std::runtime_error("EGL display doesn't support desktop OpenGL.");
+	}
+
+	EGLint const config_attributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+	EGLConfig config = nullptr;
+	EGLint configs = 0;
+	if (!eglChooseConfig(egl_display, config_attributes, &config, 1, &configs) || configs == 0) {
+		throw std::runtime_error("No EGL config supports OpenGL pbuffers.");
+	}
+
+	//OpenGL 3.3 core (with debugging), as in the windowed path:
+	EGLint const context_attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+		EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+		EGL_CONTEXT_FLAGS_KHR, EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR,
+		EGL_NONE
+	};
+	context = eglCreateContext(egl_display, config, EGL_NO_CONTEXT, context_attributes);
+	if (!context) {
+		throw std::runtime_error("Failed to create an OpenGL 3.3 core context with EGL.");
+	}
+
+	EGLSurface egl_surface = EGL_NO_SURFACE;
+	if (!has_extension(eglQueryString(egl_display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+		EGLint const pbuffer_attributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		egl_surface = eglCreatePbufferSurface(egl_display, config, pbuffer_attributes);
+		if (egl_surface == EGL_NO_SURFACE) {
+			throw std::runtime_error("Failed to create an EGL pbuffer.");
+		}
+		surface = egl_surface;
+	}
+	if (!eglMakeCurrent(egl_display, egl_surface, egl_surface, context)) {
+		throw std::runtime_error("Failed to make the EGL context current.");
+	}
+
+	std::cout << "Headless OpenGL (EGL " << major << "." << minor << (surface ? ", pbuffer" : ", surfaceless") << "): "
+		<< glGetString(GL_RENDERER) << " / " << glGetString(GL_VERSION) << std::endl;
+}
+
+void *HeadlessGL::get_proc_address(char const *name) {
+	return reinterpret_cast< void * >(eglGetProcAddress(name));
+}
+
+HeadlessGL::~HeadlessGL() {
+	if (!display) return;
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (surface) eglDestroySurface(display, surface);
+	if (context) eglDestroyContext(display, context);
+	eglTerminate(display);
+}
+
+#else //no EGL:
+
+HeadlessGL::HeadlessGL() {
+	throw std::runtime_error("Headless rendering needs EGL, which this build doesn't use.");
+}
+
+HeadlessGL::~HeadlessGL() {
+}
+
+void *HeadlessGL::get_proc_address(char const *name) {
+	return nullptr;
+}
+
+#endif
+
+//---------------------------
+
+Framebuffer::Framebuffer(glm::uvec2 size_) : size(size_) {
+	glGenRenderbuffers(1, &color);
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.x, size.y);
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size.x, size.y);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		throw std::runtime_error("Offscreen framebuffer is incomplete (status " + std::to_string(status) + ").");
+	}
+}
+
+Framebuffer::~Framebuffer() {
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &depth);
+	glDeleteRenderbuffers(1, &color);
+}
+
+void Framebuffer::bind() const {
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, size.x, size.y);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "GL.hpp"
+#include <glm/glm.hpp>
+
+//"HeadlessGL" makes an OpenGL 3.3 core context without a window, through EGL:
+// - prefers Mesa's surfaceless platform (no X server or display needed; works with llvmpipe);
+// - makes the context current with no surface if the driver allows it, or a 1x1 pbuffer if not.
+// Since there's no default framebuffer worth drawing to, render into a Framebuffer (below).
+// note: only available on Linux builds (linked with -lEGL); elsewhere the constructor throws.
+struct HeadlessGL {
+	//note: throws if a context can't be made; on return, the context is current on the calling thread.
+	HeadlessGL();
+	~HeadlessGL();
+	HeadlessGL(HeadlessGL const &) = delete;
+	HeadlessGL &operator=(HeadlessGL const &) = delete;
+
+	//look up a GL function (as SDL_GL_GetProcAddress does for windowed contexts, which SDL doesn't know about here):
+	static void *get_proc_address(char const *name);
+
+	//(EGL handles, kept opaque so EGL headers stay out of everything that includes this)
+	void *display = nullptr;
+	void *context = nullptr;
+	void *surface = nullptr; //pbuffer, if surfaceless wasn't available
+};
+
+//an offscreen render target: RGBA8 color + 24-bit depth renderbuffers:
+struct Framebuffer {
+	//note: throws if the framebuffer isn't complete.
+	Framebuffer(glm::uvec2 size);
+	~Framebuffer();
+	Framebuffer(Framebuffer const &) = delete;
+	Framebuffer &operator=(Framebuffer const &) = delete;
+
+	//bind for drawing and set the viewport to cover it:
+	void bind() const;
+
+	glm::uvec2 size;
+	GLuint framebuffer = 0;
+	GLuint color = 0;
+	GLuint depth = 0;
+};
@@ -1,11 +1,17 @@
 #include "load_save_png.hpp"
+#include "parallel_for.hpp"
 
 #include <png.h>
+#include <zlib.h>
 
 #include <iostream>
 #include <fstream>
 #include <cassert>
 #include <vector>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
 #define LOG_ERROR( X ) std::cerr << X << std::endl
 
@@ -21,8 +27,12 @@ bool load_png(std::string filename, unsigned int *width, unsigned int *height, s
 }
 
 void save_png(std::string filename, unsigned int width, unsigned int height, uint32_t const *data, OriginLocation origin) {
+	save_png(filename, width, height, data, origin, PNGEncodeOptions());
+}
+
+void save_png(std::string filename, unsigned int width, unsigned int height, uint32_t const *data, OriginLocation origin, PNGEncodeOptions const &options) {
 	std::ofstream file(filename.c_str(), std::ios::binary);
-	save_png(file, width, height, data, origin);
+	save_png(file, width, height, data, origin, options);
 }
 
 
@@ -122,7 +132,335 @@ bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vec
 }
 
 
+//---- native-layout decoder ----
+
+//reads from a PNG in memory:
+struct MemorySource {
+	uint8_t const *at;
+	uint8_t const *end;
+};
+
+static void memory_read_data(png_structp png_ptr, png_bytep data, png_size_t length) {
+	MemorySource *from = reinterpret_cast< MemorySource * >(png_get_io_ptr(png_ptr));
+	assert(from);
+	if (length > size_t(from->end - from->at)) {
+		png_error(png_ptr, "Unexpected end of data.");
+	}
+	std::memcpy(data, from->at, length);
+	from->at += length;
+}
+
+static bool load_png_native(void *io, png_rw_ptr read_data, PNGLayout *layout, PNGBufferFunction const &buffer, OriginLocation origin) {
+	assert(layout);
+	*layout = PNGLayout();
+
+	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, (png_voidp)NULL, (png_error_ptr)NULL, (png_error_ptr)NULL);
+	if (!png) {
+		LOG_ERROR("  cannot alloc read struct.");
+		return false;
+	}
+	png_set_read_fn(png, io, read_data);
+	png_infop info = png_create_info_struct(png);
+	if (!info) {
+		LOG_ERROR("  cannot alloc info struct.");
+		png_destroy_read_struct(&png, (png_infopp)NULL, (png_infopp)NULL);
+		return false;
+	}
+	png_bytep *row_pointers = NULL;
+	if (setjmp(png_jmpbuf(png))) {
+		LOG_ERROR("  png interal error.");
+		png_destroy_read_struct(&png, &info, (png_infopp)NULL);
+		if (row_pointers != NULL) delete[] row_pointers;
+		*layout = PNGLayout();
+		return false;
+	}
+	png_read_info(png, info);
+	png_byte color_type = png_get_color_type(png, info);
+	if (color_type == PNG_COLOR_TYPE_PALETTE)
+		png_set_palette_to_rgb(png);
+	if (color_type == PNG_COLOR_TYPE_GRAY && png_get_bit_depth(png, info) < 8)
+		png_set_expand_gray_1_2_4_to_8(png);
+	if (png_get_valid(png, info, PNG_INFO_tRNS))
+		png_set_tRNS_to_alpha(png);
+	if (png_get_bit_depth(png, info) == 16) {
+		const uint16_t one = 1;
+		if (*reinterpret_cast< uint8_t const * >(&one) == 1) png_set_swap(png); //(PNG is big-endian)
+	}
+	png_set_interlace_handling(png);
+	//no gray-to-RGB, no added alpha, no stripping 16 bits: whatever is left is the layout.
+
+	png_read_update_info(png, info);
+	layout->width = png_get_image_width(png, info);
+	layout->height = png_get_image_height(png, info);
+	layout->channels = png_get_channels(png, info);
+	layout->bit_depth = png_get_bit_depth(png, info);
+	assert(layout->channels >= 1 && layout->channels <= 4);
+	assert(layout->bit_depth == 8 || layout->bit_depth == 16);
+	assert(png_get_rowbytes(png, info) == layout->row_bytes());
+
+	uint8_t *data = reinterpret_cast< uint8_t * >(buffer(*layout));
+	if (!data) {
+		png_destroy_read_struct(&png, &info, NULL);
+		*layout = PNGLayout();
+		return false;
+	}
+	unsigned int h = layout->height;
+	size_t stride = layout->row_bytes();
+	row_pointers = new png_bytep[h];
+	for (unsigned int r = 0; r < h; ++r) {
+		if (origin == LowerLeftOrigin) {
+			row_pointers[h-1-r] = data + r * stride;
+		} else {
+			row_pointers[r] = data + r * stride;
+		}
+	}
+	png_read_image(png, row_pointers);
+	png_destroy_read_struct(&png, &info, NULL);
+	delete[] row_pointers;
+	return true;
+}
+
+bool load_png(std::istream &from, PNGLayout *layout, PNGBufferFunction const &buffer, OriginLocation origin) {
+	return load_png_native(&from, user_read_data, layout, buffer, origin);
+}
+
+bool load_png(void const *png, size_t png_size, PNGLayout *layout, PNGBufferFunction const &buffer, OriginLocation origin) {
+	MemorySource from;
+	from.at = reinterpret_cast< uint8_t const * >(png);
+	from.end = from.at + png_size;
+	return load_png_native(&from, memory_read_data, layout, buffer, origin);
+}
+
+bool load_png(std::string filename, PNGLayout *layout, std::vector< uint8_t > *data, OriginLocation origin) {
+	assert(data);
+	data->clear();
+	std::ifstream file(filename.c_str(), std::ios::binary);
+	if (!file) {
+		LOG_ERROR("  cannot open file.");
+		return false;
+	}
+	bool loaded = load_png(file, layout, [data](PNGLayout const &l) -> void * {
+		data->resize(l.bytes());
+		return data->data();
+	}, origin);
+	if (!loaded) data->clear();
+	return loaded;
+}
+
+std::vector< LoadedPNG > load_pngs(std::vector< PNGSource > const &sources, OriginLocation origin, uint32_t threads) {
+	std::vector< LoadedPNG > results(sources.size());
+	//(each result is only touched by the thread decoding it)
+	parallel_for(uint32_t(sources.size()), [&](uint32_t i) {
+		PNGSource const &source = sources[i];
+		LoadedPNG &result = results[i];
+		if (source.data) {
+			result.loaded = load_png(source.data, source.size, &result.layout, [&result](PNGLayout const &layout) -> void * {
+				result.pixels.resize(layout.bytes());
+				return result.pixels.data();
+			}, origin);
+			if (!result.loaded) result.pixels.clear();
+		} else {
+			result.loaded = load_png(source.filename, &result.layout, &result.pixels, origin);
+		}
+		if (!result.loaded) {
+			LOG_ERROR("  failed to load png " << (source.data ? std::string("from memory") : "'" + source.filename + "'") << " (#" << i << ").");
+		}
+	}, threads);
+	return results;
+}
+
+
+//---- parallel (strip) encoder ----
+
+//filter one row of RGBA8 pixels ('prior' is the unfiltered row above, or null for the first row):
+// (writes the filter type byte, then the filtered bytes, to 'out')
+static void apply_filter(PNGEncodeOptions::Filter filter, uint8_t const *row, uint8_t const *prior, size_t bytes, uint8_t *out) {
+	const size_t bpp = 4;
+	out[0] = uint8_t(filter - PNGEncodeOptions::NoFilter); //(PNG filter type numbers: None = 0, ..., Paeth = 4)
+	out += 1;
+	//(the first row is filtered as if the row above were zeros, so Up is None, Average is half of Sub, and Paeth is Sub)
+	if (!prior && filter == PNGEncodeOptions::UpFilter) filter = PNGEncodeOptions::NoFilter;
+	if (!prior && filter == PNGEncodeOptions::PaethFilter) filter = PNGEncodeOptions::SubFilter;
+	size_t i = 0;
+	switch (filter) {
+	case PNGEncodeOptions::SubFilter:
+		for (; i < bpp; ++i) out[i] = row[i];
+		for (; i < bytes; ++i) out[i] = uint8_t(row[i] - row[i - bpp]);
+		break;
+	case PNGEncodeOptions::UpFilter:
+		for (; i < bytes; ++i) out[i] = uint8_t(row[i] - prior[i]);
+		break;
+	case PNGEncodeOptions::AverageFilter:
+		for (; i < bpp; ++i) out[i] = uint8_t(row[i] - (prior ? prior[i] : 0) / 2);
+		for (; i < bytes; ++i) out[i] = uint8_t(row[i] - (row[i - bpp] + (prior ? prior[i] : 0)) / 2);
+		break;
+	case PNGEncodeOptions::PaethFilter:
+		for (; i < bpp; ++i) out[i] = uint8_t(row[i] - prior[i]); //(left and up-left are zero)
+		for (; i < bytes; ++i) {
+			int a = row[i - bpp], b = prior[i], c = prior[i - bpp];
+			int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+			int predicted = (pa <= pb && pa <= pc ? a : (pb <= pc ? b : c));
+			out[i] = uint8_t(row[i] - predicted);
+		}
+		break;
+	default:
+		std::copy(row, row + bytes, out);
+		break;
+	}
+}
+
+static void filter_row(PNGEncodeOptions::Filter filter, uint8_t const *row, uint8_t const *prior, size_t bytes, uint8_t *out) {
+	if (filter != PNGEncodeOptions::AdaptiveFilter) {
+		apply_filter(filter, row, prior, bytes, out);
+		return;
+	}
+	//adaptive: smallest sum of (signed) filtered bytes, as libpng does:
+	vector< uint8_t > attempt(1 + bytes);
+	uint64_t best = -1ULL;
+	for (int f = PNGEncodeOptions::NoFilter; f <= PNGEncodeOptions::PaethFilter; ++f) {
+		apply_filter(PNGEncodeOptions::Filter(f), row, prior, bytes, attempt.data());
+		uint64_t sum = 0;
+		for (size_t i = 1; i <= bytes; ++i) {
+			sum += std::abs(int(int8_t(attempt[i])));
+		}
+		if (sum < best) {
+			best = sum;
+			std::copy(attempt.begin(), attempt.end(), out);
+		}
+	}
+}
+
+static int zlib_level(PNGEncodeOptions const &options) {
+	return (options.level < 0 ? Z_DEFAULT_COMPRESSION : std::min(options.level, 9));
+}
+
+static int zlib_strategy(PNGEncodeOptions::Strategy strategy) {
+	if (strategy == PNGEncodeOptions::FilteredStrategy) return Z_FILTERED;
+	if (strategy == PNGEncodeOptions::HuffmanOnlyStrategy) return Z_HUFFMAN_ONLY;
+	if (strategy == PNGEncodeOptions::RLEStrategy) return Z_RLE;
+	return Z_DEFAULT_STRATEGY;
+}
+
+static void write_u32(std::ostream &to, uint32_t value) {
+	char bytes[4] = { char(value >> 24), char(value >> 16), char(value >> 8), char(value) };
+	to.write(bytes, 4);
+}
+
+static void write_chunk(std::ostream &to, char const *type, uint8_t const *data, size_t size) {
+	write_u32(to, uint32_t(size));
+	to.write(type, 4);
+	to.write(reinterpret_cast< char const * >(data), size);
+	uLong crc = crc32(0L, Z_NULL, 0);
+	crc = crc32(crc, reinterpret_cast< Bytef const * >(type), 4);
+	crc = crc32(crc, data, uInt(size));
+	write_u32(to, uint32_t(crc));
+}
+
+//each strip of rows is filtered and compressed on its own; since every strip but the last ends with
+// a sync flush (an empty stored block, which byte-aligns the output), their raw deflate streams can
+// be concatenated, and the whole thing gets one zlib header and an adler32 combined from the strips':
+static void save_png_strips(std::ostream &to, unsigned int width, unsigned int height, uint32_t const *data, OriginLocation origin, PNGEncodeOptions const &options) {
+	size_t const row_bytes = size_t(width) * 4;
+	unsigned int const strips = std::min(options.threads, height);
+
+	//row 'y' of the PNG (which is stored top row first):
+	auto row = [&](unsigned int y) -> uint8_t const * {
+		unsigned int r = (origin == UpperLeftOrigin ? y : height - 1 - y);
+		return reinterpret_cast< uint8_t const * >(data + size_t(r) * width);
+	};
+
+	struct Strip {
+		vector< uint8_t > deflated;
+		uLong adler = 0;
+		size_t filtered_bytes = 0;
+		bool ok = false;
+	};
+	vector< Strip > out(strips);
+	auto encode_strip = [&](unsigned int s) {
+		Strip &strip = out[s];
+		unsigned int begin = uint32_t(uint64_t(height) * s / strips);
+		unsigned int end = uint32_t(uint64_t(height) * (s + 1) / strips);
+
+		vector< uint8_t > filtered((end - begin) * (1 + row_bytes));
+		for (unsigned int y = begin; y < end; ++y) {
+			filter_row(options.filter, row(y), (y > 0 ? row(y - 1) : nullptr), row_bytes, &filtered[(y - begin) * (1 + row_bytes)]);
+		}
+		strip.filtered_bytes = filtered.size();
+		strip.adler = adler32(adler32(0L, Z_NULL, 0), filtered.data(), uInt(filtered.size()));
+
+		z_stream z;
+		z.zalloc = Z_NULL;
+		z.zfree = Z_NULL;
+		z.opaque = Z_NULL;
+		if (deflateInit2(&z, zlib_level(options), Z_DEFLATED, -15, 8, zlib_strategy(options.strategy)) != Z_OK) return; //(-15: raw deflate)
+		size_t const header = (s == 0 ? 2 : 0); //(room for the zlib header in the first strip)
+		strip.deflated.resize(header + deflateBound(&z, uLong(filtered.size())) + 16);
+		z.next_in = filtered.data();
+		z.avail_in = uInt(filtered.size());
+		z.next_out = strip.deflated.data() + header;
+		z.avail_out = uInt(strip.deflated.size() - header);
+		int result = deflate(&z, (s + 1 == strips ? Z_FINISH : Z_SYNC_FLUSH));
+		strip.ok = (s + 1 == strips ? result == Z_STREAM_END : result == Z_OK) && z.avail_in == 0;
+		strip.deflated.resize(strip.deflated.size() - z.avail_out);
+		deflateEnd(&z);
+	};
+	vector< std::thread > helpers;
+	for (unsigned int s = 1; s < strips; ++s) {
+		helpers.emplace_back(encode_strip, s);
+	}
+	encode_strip(0);
+	for (auto &helper : helpers) {
+		helper.join();
+	}
+	for (auto const &strip : out) {
+		if (!strip.ok) {
+			LOG_ERROR("Error compressing png.");
+			return;
+		}
+	}
+
+	//zlib header (deflate, 32k window; FLEVEL just describes the level) and adler32 trailer:
+	int level = zlib_level(options);
+	out[0].deflated[0] = 0x78;
+	out[0].deflated[1] = (level == Z_DEFAULT_COMPRESSION || (level >= 2 && level <= 6) ? 0x9c : (level < 2 ? 0x01 : 0xda));
+	uLong adler = out[0].adler;
+	for (unsigned int s = 1; s < strips; ++s) {
+		adler = adler32_combine(adler, out[s].adler, z_off_t(out[s].filtered_bytes));
+	}
+	vector< uint8_t > &last = out[strips - 1].deflated;
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		last.push_back(uint8_t(adler >> shift));
+	}
+
+	static uint8_t const signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+	to.write(reinterpret_cast< char const * >(signature), 8);
+	uint8_t ihdr[13] = {
+		uint8_t(width >> 24), uint8_t(width >> 16), uint8_t(width >> 8), uint8_t(width),
+		uint8_t(height >> 24), uint8_t(height >> 16), uint8_t(height >> 8), uint8_t(height),
+		8, //bit depth
+		6, //color type: RGBA
+		0, 0, 0 //compression, filter, interlace: the standard ones
+	};
+	write_chunk(to, "IHDR", ihdr, sizeof(ihdr));
+	for (auto const &strip : out) {
+		write_chunk(to, "IDAT", strip.deflated.data(), strip.deflated.size());
+	}
+	write_chunk(to, "IEND", nullptr, 0);
+	if (!to) {
+		LOG_ERROR("Error writing png.");
+	}
+}
+
+
 void save_png(std::ostream &to, unsigned int width, unsigned int height, uint32_t const *data, OriginLocation origin) {
+	save_png(to, width, height, data, origin, PNGEncodeOptions());
+}
+
+void save_png(std::ostream &to, unsigned int width, unsigned int height, uint32_t const *data, OriginLocation origin, PNGEncodeOptions const &options) {
+	if (options.threads > 1 && height > 1 && width > 0) {
+		save_png_strips(to, width, height, data, origin, options);
+		return;
+	}
 //After the libpng example.c
 	png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 
@@ -148,6 +486,16 @@ void save_png(std::ostream &to, unsigned int width, unsigned int height, uint32_
 
 	//Not needed with custom read/write functions: png_init_io(png_ptr, fp);
 	png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+	if (options.level >= 0) {
+		png_set_compression_level(png_ptr, std::min(options.level, 9));
+	}
+	if (options.filter != PNGEncodeOptions::AdaptiveFilter) {
+		static int const masks[] = { PNG_FILTER_NONE, PNG_FILTER_SUB, PNG_FILTER_UP, PNG_FILTER_AVG, PNG_FILTER_PAETH };
+		png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, masks[options.filter - PNGEncodeOptions::NoFilter]);
+	}
+	if (options.strategy != PNGEncodeOptions::DefaultStrategy) {
+		png_set_compression_strategy(png_ptr, zlib_strategy(options.strategy));
+	}
 
 	png_write_info(png_ptr, info_ptr);
 	//png_set_swap_alpha(png_ptr) // might need?
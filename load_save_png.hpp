@@ -2,6 +2,8 @@
 
 #include <string>
 #include <vector>
+#include <functional>
+#include <cstddef>
 #include <stdint.h>
 
 /*
@@ -18,3 +20,81 @@ void save_png(std::string filename, unsigned int width, unsigned int height, uin
 
 bool load_png(std::istream &from, unsigned int *width, unsigned int *height, std::vector< uint32_t > *data, OriginLocation origin = UpperLeftOrigin);
 void save_png(std::ostream &to, unsigned int width, unsigned int height, uint32_t const *data, OriginLocation origin = UpperLeftOrigin);
+
+/*
+ * How save_png compresses. The defaults are libpng's (small files, but slow);
+ * for frame capture, a low level with a fixed filter is many times faster.
+ */
+
+struct PNGEncodeOptions {
+	int level = -1; //zlib level, from 0 (just store) to 9 (smallest); -1 is zlib's default (6)
+	enum Filter {
+		AdaptiveFilter, //try every filter on each row; keep the one that looks most compressible
+		NoFilter,
+		SubFilter, //difference from the pixel to the left
+		UpFilter, //difference from the pixel above
+		AverageFilter,
+		PaethFilter,
+	} filter = AdaptiveFilter;
+	enum Strategy {
+		DefaultStrategy,
+		FilteredStrategy,
+		HuffmanOnlyStrategy, //no string matching at all (fastest)
+		RLEStrategy, //only match runs (fast; good for flat-colored images)
+	} strategy = DefaultStrategy;
+	//more than one: split the image into this many strips of rows, filter + deflate them in
+	// parallel (pigz-style: each ends on a byte boundary), and stitch them into one zlib stream:
+	unsigned int threads = 1;
+};
+
+void save_png(std::string filename, unsigned int width, unsigned int height, uint32_t const *data, OriginLocation origin, PNGEncodeOptions const &options);
+void save_png(std::ostream &to, unsigned int width, unsigned int height, uint32_t const *data, OriginLocation origin, PNGEncodeOptions const &options);
+
+/*
+ * Load a PNG in (close to) the layout it's stored in, rather than always as RGBA8:
+ * gray stays one channel (R8 / R16), gray+alpha two (RG8 / RG16), RGB three, RGBA four.
+ * Only what GL can't take directly is expanded: palettes become RGB (RGBA with
+ * transparency), 1/2/4-bit gray becomes 8-bit, and a tRNS color key becomes alpha.
+ */
+
+struct PNGLayout {
+	unsigned int width = 0, height = 0;
+	unsigned int channels = 0; //1 to 4
+	unsigned int bit_depth = 0; //8 or 16 (16-bit samples come out in native byte order, ready for GL_UNSIGNED_SHORT)
+	size_t row_bytes() const { return size_t(width) * channels * (bit_depth / 8); } //(rows are tightly packed)
+	size_t bytes() const { return row_bytes() * height; }
+};
+
+//called once the layout is known; returns where to decode to (room for layout.bytes()), or null to give up:
+typedef std::function< void *(PNGLayout const &layout) > PNGBufferFunction;
+
+//decode into the caller's buffer (e.g., a mapped pixel-unpack buffer) -- returns false on failure:
+bool load_png(std::istream &from, PNGLayout *layout, PNGBufferFunction const &buffer, OriginLocation origin = UpperLeftOrigin);
+//...same, from a PNG already in memory (e.g., part of a packed asset file):
+bool load_png(void const *png, size_t png_size, PNGLayout *layout, PNGBufferFunction const &buffer, OriginLocation origin = UpperLeftOrigin);
+//...same, into a vector (resized to layout.bytes()):
+bool load_png(std::string filename, PNGLayout *layout, std::vector< uint8_t > *data, OriginLocation origin);
+
+/*
+ * Load many PNGs at once (e.g., a game's texture set), decoding them in parallel.
+ */
+
+//a file, or (if 'data' isn't null) a PNG already in memory:
+struct PNGSource {
+	PNGSource(std::string const &filename_) : filename(filename_) { }
+	PNGSource(void const *data_, size_t size_) : data(data_), size(size_) { }
+	std::string filename;
+	void const *data = nullptr;
+	size_t size = 0;
+};
+
+struct LoadedPNG {
+	bool loaded = false; //(if not, layout and pixels are empty)
+	PNGLayout layout;
+	std::vector< uint8_t > pixels;
+};
+
+//decode every source in native layout (as load_png, above), spread over up to 'threads'
+// threads (0 => one per core); each decode has its own libpng state, so nothing is shared:
+// returns one result per source, in the same order.
+std::vector< LoadedPNG > load_pngs(std::vector< PNGSource > const &sources, OriginLocation origin, uint32_t threads = 0);
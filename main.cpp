@@ -1,6 +1,16 @@
 #include "load_save_png.hpp"
 #include "GL.hpp"
 #include "Meshes.hpp"
+#include "AssetLoader.hpp"
+#include "GLUploader.hpp"
+#include "timeline.hpp"
+#include "shader_variants.hpp"
+#include "program_cache.hpp"
+#include "headless.hpp"
+#include "FrameCapture.hpp"
+#include "TextureArray.hpp"
+#include "DebugOutput.hpp"
+#include "FrameTimers.hpp"
 #include "Scene.hpp"
 #include "read_chunk.hpp"
 
@@ -14,140 +24,327 @@
 #include <algorithm>
 #include <stdexcept>
 #include <fstream>
-
-static GLuint compile_shader(GLenum type, std::string const &source);
-static GLuint link_program(GLuint vertex_shader, GLuint fragment_shader);
+#include <memory>
+#include <cstdlib>
+#include <cstdio>
+#include <thread>
 
 int main(int argc, char **argv) {
 	//Configuration:
 	struct {
 		std::string title = "Game2: Scene";
 		glm::uvec2 size = glm::uvec2(1000, 700);
+		size_t upload_budget = 4 << 20; //bytes of vertex data to upload per frame while assets stream in
+		bool fog = false; //draw with distance fog (selects shader variants with ShaderVariants::Fog)
+		bool depth_prepass = false; //fill depth before shading opaque objects (see Scene::depth_prepass; toggle with F2)
+		bool stats = false; //print where frame time goes (CPU and GPU, see FrameTimers) about once a second (toggle with F3)
+		//headless mode renders into an offscreen framebuffer (of 'size') with an EGL context -- no window, no vsync;
+		// once the scene has streamed in, it times 'frames' frames, saves the last to 'output' (if set), and exits:
+		bool headless = false;
+		uint32_t frames = 100;
+		std::string output;
+		bool strict_gl = false; //exit with an error if the driver reports errors or performance problems during the timed frames (for CI)
+		//frame sequences (F11 starts/stops one; see FrameCapture::start_sequence):
+		std::string record; //if set, start recording a sequence here once the scene has streamed in
+		bool record_raw = false; //one preallocated file of uncompressed frames instead of PNGs
+		uint32_t record_frames = 3600; //at most this many frames per sequence
+		uint32_t capture_encoders = std::max(1U, std::thread::hardware_concurrency() / 2); //threads writing frames
 	} config;
 
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--headless") {
+			config.headless = true;
+		} else if (arg == "--size" && i + 1 < argc) {
+			unsigned int x = 0, y = 0;
+			if (std::sscanf(argv[++i], "%ux%u", &x, &y) != 2 || x == 0 || y == 0) {
+				std::cerr << "Expected WIDTHxHEIGHT after --size, got '" << argv[i] << "'." << std::endl;
+				return 1;
+			}
+			config.size = glm::uvec2(x, y);
+		} else if (arg == "--frames" && i + 1 < argc) {
+			config.frames = std::max(1, std::atoi(argv[++i]));
+		} else if (arg == "--output" && i + 1 < argc) {
+			config.output = argv[++i];
+		} else if (arg == "--stats") {
+			config.stats = true;
+		} else if (arg == "--strict-gl") {
+			config.strict_gl = true;
+		} else if (arg == "--record" && i + 1 < argc) {
+			config.record = argv[++i];
+		} else if (arg == "--raw") {
+			config.record_raw = true;
+		} else if (arg == "--encoders" && i + 1 < argc) {
+			config.capture_encoders = std::max(1, std::atoi(argv[++i]));
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--size WIDTHxHEIGHT] [--stats] [--record path [--raw] [--encoders N]] [--headless [--frames N] [--output frame.png] [--strict-gl]]" << std::endl;
+			return 1;
+		}
+	}
+
+	timeline_mark("main()");
+
+	//the scene and the meshes it uses are read on a background thread (no GL needed), starting
+	// now so it overlaps window and context creation; the game loop adds them as they arrive:
+	AssetLoader loader("scene.blob", "meshes.blob");
+
 	//------------  initialization ------------
 
-	//Initialize SDL library:
-	SDL_Init(SDL_INIT_VIDEO);
-
-	//Ask for an OpenGL context version 3.3, core profile, enable debug:
-	SDL_GL_ResetAttributes();
-	SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
-	SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-
-	//create window:
-	SDL_Window *window = SDL_CreateWindow(
-		config.title.c_str(),
-		SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-		config.size.x, config.size.y,
-		SDL_WINDOW_OPENGL /*| SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI*/
-	);
+	SDL_Window *window = nullptr;
+	SDL_GLContext context = nullptr;
+	std::unique_ptr< HeadlessGL > headless; //(in headless mode, the context comes from here instead)
+	if (config.headless) {
+		try {
+			headless.reset(new HeadlessGL());
+		} catch (std::exception &e) {
+			std::cerr << "Error creating headless OpenGL context: " << e.what() << std::endl;
+			return 1;
+		}
+	} else {
+		//Initialize SDL library:
+		SDL_Init(SDL_INIT_VIDEO);
+		timeline_mark("SDL_Init");
+
+		//Ask for an OpenGL context version 3.3, core profile, enable debug:
+		SDL_GL_ResetAttributes();
+		SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
+		SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
+		SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE, 8);
+		SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE, 8);
+		SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+		SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
+		SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+
+		//create window:
+		window = SDL_CreateWindow(
+			config.title.c_str(),
+			SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+			config.size.x, config.size.y,
+			SDL_WINDOW_OPENGL /*| SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI*/
+		);
 
-	if (!window) {
-		std::cerr << "Error creating SDL window: " << SDL_GetError() << std::endl;
-		return 1;
-	}
+		if (!window) {
+			std::cerr << "Error creating SDL window: " << SDL_GetError() << std::endl;
+			return 1;
+		}
 
-	//Create OpenGL context:
-	SDL_GLContext context = SDL_GL_CreateContext(window);
+		timeline_mark("window created");
 
-	if (!context) {
-		SDL_DestroyWindow(window);
-		std::cerr << "Error creating OpenGL context: " << SDL_GetError() << std::endl;
-		return 1;
-	}
+		//Create OpenGL context:
+		context = SDL_GL_CreateContext(window);
 
-	#ifdef _WIN32
-	//On windows, load OpenGL extensions:
-	if (!init_gl_shims()) {
-		std::cerr << "ERROR: failed to initialize shims." << std::endl;
-		return 1;
-	}
-	#endif
+		if (!context) {
+			SDL_DestroyWindow(window);
+			std::cerr << "Error creating OpenGL context: " << SDL_GetError() << std::endl;
+			return 1;
+		}
 
-	//Set VSYNC + Late Swap (prevents crazy FPS):
-	if (SDL_GL_SetSwapInterval(-1) != 0) {
-		std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
-		if (SDL_GL_SetSwapInterval(1) != 0) {
-			std::cerr << "NOTE: couldn't set vsync (" << SDL_GetError() << ")." << std::endl;
+		#ifdef _WIN32
+		//On windows, load OpenGL extensions:
+		if (!init_gl_shims()) {
+			std::cerr << "ERROR: failed to initialize shims." << std::endl;
+			return 1;
+		}
+		#endif
+
+		//Set VSYNC + Late Swap (prevents crazy FPS):
+		if (SDL_GL_SetSwapInterval(-1) != 0) {
+			std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
+			if (SDL_GL_SetSwapInterval(1) != 0) {
+				std::cerr << "NOTE: couldn't set vsync (" << SDL_GetError() << ")." << std::endl;
+			}
 		}
 	}
 
+	timeline_mark("GL context created");
+
 	//Hide mouse cursor (note: showing can be useful for debugging):
 	//SDL_ShowCursor(SDL_DISABLE);
 
-	//------------ opengl objects / game assets ------------
+	//GL functions beyond gl_shims are looked up through whichever library made the context:
+	void *(*get_proc_address)(char const *) = (config.headless ? &HeadlessGL::get_proc_address : [](char const *name) { return SDL_GL_GetProcAddress(name); });
 
-	//shader program:
-	GLuint program = 0;
-	GLuint program_Position = 0;
-	GLuint program_Normal = 0;
-	GLuint program_mvp = 0;
-	GLuint program_itmv = 0;
-	GLuint program_to_light = 0;
-	{ //compile shader program:
-		GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER,
-			"#version 330\n"
-			"uniform mat4 mvp;\n"
-			"uniform mat3 itmv;\n"
-			"in vec4 Position;\n"
-			"in vec3 Normal;\n"
-			"out vec3 normal;\n"
-			"void main() {\n"
-			"	gl_Position = mvp * Position;\n"
-			"	normal = itmv * Normal;\n"
-			"}\n"
-		);
+	//report what the driver has to say about how it's being used (before anything is compiled or uploaded):
+	std::unique_ptr< DebugOutput > debug(new DebugOutput(get_proc_address));
 
-		GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER,
-			"#version 330\n"
-			"uniform vec3 to_light;\n"
-			"in vec3 normal;\n"
-			"out vec4 fragColor;\n"
-			"void main() {\n"
-			"	float light = max(0.0, dot(normalize(normal), to_light));\n"
-			"	fragColor = vec4(light * vec3(1.0, 1.0, 1.0), 1.0);\n"
-			"}\n"
-		);
+	//reuse program binaries saved by earlier runs (see cached_program):
+	init_program_binaries(get_proc_address);
 
-		program = link_program(fragment_shader, vertex_shader);
+	//time each part of every frame, on the CPU and (without waiting for it) the GPU:
+	std::unique_ptr< FrameTimers > timers(new FrameTimers());
 
-		//look up attribute locations:
-		program_Position = glGetAttribLocation(program, "Position");
-		if (program_Position == -1U) throw std::runtime_error("no attribute named Position");
-		program_Normal = glGetAttribLocation(program, "Normal");
-		if (program_Normal == -1U) throw std::runtime_error("no attribute named Normal");
+	//------------ opengl objects / game assets ------------
 
-		//look up uniform locations:
-		program_mvp = glGetUniformLocation(program, "mvp");
-		if (program_mvp == -1U) throw std::runtime_error("no uniform named mvp");
-		program_itmv = glGetUniformLocation(program, "itmv");
-		if (program_itmv == -1U) throw std::runtime_error("no uniform named itmv");
+	//shader programs (specialized per object, see ShaderVariants):
+	ShaderVariants shaders(
+		"#ifdef INSTANCED\n"
+		"uniform mat4 projection;\n"
+		"struct Instance { mat4 mv; vec4 layer; };\n" //(see Scene::Instance)
+		"layout(std140) uniform Instances { Instance instances[MAX_INSTANCES]; };\n"
+		"#else\n"
+		"uniform mat4 mvp;\n"
+		"#if defined(UNIFORM_SCALE) || defined(FOG)\n"
+		"uniform mat4 mv;\n"
+		"#endif\n"
+		"#ifndef UNIFORM_SCALE\n"
+		"uniform mat3 itmv;\n"
+		"#endif\n"
+		"#ifdef TEXTURED\n"
+		"uniform float layer;\n"
+		"#endif\n"
+		"#endif\n"
+		"layout(location = 0) in vec4 Position;\n"
+		"layout(location = 1) in vec3 Normal;\n"
+		"invariant gl_Position;\n" //(so depths match the depth pre-pass exactly)
+		"#ifdef VERTEX_COLORS\n"
+		"layout(location = 2) in vec4 Color;\n"
+		"#endif\n"
+		"#ifdef TEXTURED\n"
+		"layout(location = 3) in vec2 TexCoord;\n"
+		"out vec3 texcoord;\n"
+		"#endif\n"
+		"out vec3 normal;\n"
+		"out vec4 color;\n"
+		"#ifdef FOG\n"
+		"out float camera_distance;\n"
+		"#endif\n"
+		"void main() {\n"
+		"#ifdef INSTANCED\n"
+		"	mat4 mv = instances[gl_InstanceID].mv;\n"
+		"	mat4 mvp = projection * mv;\n"
+		"	float layer = instances[gl_InstanceID].layer.x;\n"
+		"#ifndef UNIFORM_SCALE\n"
+		"	mat3 itmv = inverse(transpose(mat3(mv)));\n"
+		"#endif\n"
+		"#endif\n"
+		"	gl_Position = mvp * Position;\n"
+		"#ifdef UNIFORM_SCALE\n"
+		"	normal = mat3(mv) * Normal;\n" //(uniform scale only changes the length, and the fragment shader normalizes)
+		"#else\n"
+		"	normal = itmv * Normal;\n"
+		"#endif\n"
+		"#ifdef VERTEX_COLORS\n"
+		"	color = Color;\n"
+		"#else\n"
+		"	color = vec4(1.0);\n"
+		"#endif\n"
+		"#ifdef TEXTURED\n"
+		"	texcoord = vec3(TexCoord, layer);\n"
+		"#endif\n"
+		"#ifdef FOG\n"
+		"	camera_distance = length((mv * Position).xyz);\n"
+		"#endif\n"
+		"}\n"
+		,
+		"uniform vec3 to_light;\n"
+		"in vec3 normal;\n"
+		"in vec4 color;\n"
+		"#ifdef TEXTURED\n"
+		"uniform sampler2DArray tex;\n"
+		"in vec3 texcoord;\n"
+		"#endif\n"
+		"#ifdef FOG\n"
+		"in float camera_distance;\n"
+		"const vec3 fog_color = vec3(0.5, 0.5, 0.5);\n" //(matches the clear color)
+		"const float fog_density = 0.15;\n"
+		"#endif\n"
+		"out vec4 fragColor;\n"
+		"void main() {\n"
+		"	vec4 albedo = color;\n"
+		"#ifdef TEXTURED\n"
+		"	albedo *= texture(tex, texcoord);\n"
+		"#endif\n"
+		"	float light = max(0.0, dot(normalize(normal), to_light));\n"
+		"	vec3 rgb = light * albedo.rgb;\n"
+		"#ifdef FOG\n"
+		"	rgb = mix(fog_color, rgb, exp(-fog_density * camera_distance));\n"
+		"#endif\n"
+		"	fragColor = vec4(rgb, albedo.a);\n"
+		"}\n"
+	);
 
-		program_to_light = glGetUniformLocation(program, "to_light");
-		if (program_to_light == -1U) throw std::runtime_error("no uniform named to_light");
-	}
+	//features every object gets:
+	uint32_t const base_features = ShaderVariants::VertexColors | (config.fog ? uint32_t(ShaderVariants::Fog) : 0U);
+	//build the variants the scene will (most likely) use now, rather than when objects show up:
+	shaders.get(base_features | ShaderVariants::UniformScale);
+	shaders.get(base_features);
+	shaders.get(base_features | ShaderVariants::UniformScale | ShaderVariants::Textured | ShaderVariants::Instanced); //(balls)
+
+	//depth-only program for the depth pre-pass (computes gl_Position the same way as above):
+	GLuint depth_program = cached_program(
+		"#version 330\n"
+		"uniform mat4 mvp;\n"
+		"layout(location = 0) in vec4 Position;\n"
+		"invariant gl_Position;\n"
+		"void main() {\n"
+		"	gl_Position = mvp * Position;\n"
+		"}\n"
+		,
+		"#version 330\n"
+		"void main() {\n"
+		"}\n"
+	);
+	GLuint depth_program_mvp = glGetUniformLocation(depth_program, "mvp");
+	timeline_mark("shaders ready");
 
 	//------------ meshes ------------
 
 	Meshes meshes;
 
-	{ //add meshes to database:
-		Meshes::Attributes attributes;
-		attributes.Position = program_Position;
-		attributes.Normal = program_Normal;
+	Meshes::Attributes attributes;
+	attributes.Position = ShaderVariants::PositionLocation;
+	attributes.Normal = ShaderVariants::NormalLocation;
+	attributes.Color = ShaderVariants::ColorLocation;
+	attributes.TexCoord = ShaderVariants::TexCoordLocation;
+
+	//the numbered faces of the pool balls, one layer each (ball N uses layer N-1):
+	// (compiled, with their mip levels, into textures.blob; or else straight from the PNGs;
+	//  without either, balls are drawn with their vertex colors)
+	std::unique_ptr< TextureArray > ball_faces;
+	try {
+		ball_faces.reset(new TextureArray("textures.blob", "ball-faces"));
+	} catch (std::exception &e) {
+		std::cerr << "NOTE: " << e.what() << " Loading ball faces from PNGs instead." << std::endl;
+		try {
+			std::vector< std::string > filenames;
+			for (uint32_t n = 1; n <= 15; ++n) {
+				filenames.emplace_back("textures/ball-" + std::to_string(n) + ".png");
+			}
+			ball_faces.reset(new TextureArray(filenames));
+		} catch (std::exception &png_error) {
+			std::cerr << "WARNING: drawing balls without their numbers: " << png_error.what() << std::endl;
+		}
+	}
+	timeline_mark("textures loaded");
+
+	//meshes from the loader get copied into GL buffers by a thread with its own (shared) context:
+	GLUploader uploader(window, context);
 
-		meshes.load("meshes.blob", attributes);
+	//headless frames are drawn here (there's no window to show them in):
+	std::unique_ptr< Framebuffer > offscreen;
+	if (config.headless) {
+		offscreen.reset(new Framebuffer(config.size));
+		offscreen->bind();
 	}
+
+	//screenshots (F12) and frame sequences (F11) are read back and saved a few frames later, off the render thread:
+	// (enough buffers for every encoder to be busy while a couple of frames are still being read back)
+	FrameCapture capture(config.size, config.capture_encoders + 3, config.capture_encoders);
+	uint32_t screenshots = 0;
+	bool screenshot_requested = false;
+	uint32_t sequences = 0;
+	auto start_recording = [&](std::string const &path) {
+		try {
+			capture.start_sequence(path, (config.record_raw ? FrameCapture::RawSequence : FrameCapture::PNGSequence), config.record_frames);
+			std::cout << "Recording to '" << path << "'." << std::endl;
+		} catch (std::exception &e) {
+			std::cerr << "WARNING: not recording: " << e.what() << std::endl;
+		}
+	};
 	
 	//------------ scene ------------
 
@@ -157,52 +354,85 @@ int main(int argc, char **argv) {
 	scene.camera.aspect = float(config.size.x) / float(config.size.y);
 	scene.camera.near = 0.01f;
 	//(transform will be handled in the update function below)
+	scene.depth_prepass = config.depth_prepass;
+	scene.depth_program = depth_program;
+	scene.depth_program_mvp = depth_program_mvp;
+	scene.timers = timers.get();
+
+	//pick a shader variant for an object; uniformly-scaled objects can skip the inverse-transpose:
+	// (an object whose scale later becomes non-uniform needs to pick again)
+	auto set_program = [&](Scene::Object &object, bool instanced) {
+		uint32_t features = base_features;
+		glm::vec3 const &scale = object.transform.scale;
+		if (scale.x == scale.y && scale.y == scale.z) features |= ShaderVariants::UniformScale;
+		if (object.texture) features |= ShaderVariants::Textured;
+		if (instanced) features |= ShaderVariants::Instanced;
+		ShaderVariants::Variant const &variant = shaders.get(features);
+		object.program = variant.program;
+		object.program_mvp = variant.mvp;
+		object.program_mv = variant.mv;
+		object.program_itmv = variant.itmv;
+		object.program_layer = variant.layer;
+		object.program_projection = variant.projection;
+	};
+
+	//point an object at a mesh's vertex data:
+	auto set_mesh = [&](Scene::Object &object, Mesh const &mesh) {
+		object.vao = mesh.vao;
+		object.start = mesh.start;
+		object.count = mesh.count;
+		static_assert(int(Scene::Object::MaxLODs) == int(Mesh::MaxLODs), "Scene and Mesh agree on level-of-detail count");
+		object.lod_count = mesh.lod_count;
+		for (uint32_t l = 0; l < mesh.lod_count; ++l) {
+			object.lods[l].start = mesh.lods[l].start;
+			object.lods[l].count = mesh.lods[l].count;
+		}
+		object.center = mesh.center;
+		object.radius = mesh.radius;
+		//meshes with see-through vertex colors get drawn in the blended pass:
+		object.material = (mesh.translucent ? uint32_t(Scene::Object::Transparent) : 0U);
+		//meshes without texture coordinates (e.g., from older mesh files) can't be textured:
+		if (object.texture && !mesh.has_texcoords) {
+			object.texture = 0;
+			set_program(object, object.program_projection != -1U);
+		}
+	};
+
+	//objects whose meshes haven't been uploaded yet (they draw nothing until then):
+	std::vector< std::pair< Scene::Object *, MeshID > > waiting_objects;
 
 	//add some objects from the mesh library:
-	auto add_object = [&](std::string const &name, glm::vec3 const &position, glm::quat const &rotation, glm::vec3 const &scale) -> Scene::Object & {
-		Mesh const &mesh = meshes.get(name);
+	// (objects with 'instanced' set are drawn along with others that share their mesh; see Scene::render)
+	auto add_object = [&](MeshID mesh_id, glm::vec3 const &position, glm::quat const &rotation, glm::vec3 const &scale, GLuint texture = 0, uint32_t layer = 0, bool instanced = false) -> Scene::Object & {
 		scene.objects.emplace_back();
 		Scene::Object &object = scene.objects.back();
 		object.transform.position = position;
 		object.transform.rotation = rotation;
 		object.transform.scale = scale;
-		object.vao = mesh.vao;
-		object.start = mesh.start;
-		object.count = mesh.count;
-		object.program = program;
-		object.program_mvp = program_mvp;
-		object.program_itmv = program_itmv;
+		object.texture = texture;
+		object.layer = layer;
+		set_program(object, instanced);
+		if (Mesh const *mesh = meshes.find(mesh_id)) {
+			set_mesh(object, *mesh);
+		} else {
+			waiting_objects.emplace_back(&object, mesh_id);
+		}
 		return object;
 	};
 
-	auto object_is_cylinder = [&](std::string const &name) {
-		//printf("name: %s\n", name);
-		if (name.find("Cylinder") != std::string::npos)
-			return true;
-		return false;
-	};
-
-	auto object_is_ball = [&](std::string const &name) {
-		if (name.find("Ball") != std::string::npos)
-			return true;
-		return false;
-	};
-
-	auto object_is_dozer = [&](std::string const &name) {
-		if (name.find("Circle") != std::string::npos)
-			return true;
-		return false;
-	};
-
 	std::vector< Scene::Object * > ball_object_list;
 	std::vector< Scene::Object * > dozer_object_list;
 	std::vector< Scene::Object * > cylinder_object_list;
+	//collision radius of each object in the lists above (from the scene's tags):
+	std::vector< float > ball_radius;
+	std::vector< float > dozer_radius;
+	std::vector< float > cylinder_radius;
 	std::vector< int > dozer1_wheel_dir(4, 0);
 	std::vector< int > dozer2_wheel_dir(4, 0);
 	std::vector< float > dozer_rotation(2, 0.0f);
 	std::vector< float > ball_rotation(ball_object_list.size(), 0.0f);
-	float collision_radius = 0.15f; //collision radius of balls and dozers
-	float score_collision_radius = 0.4f; //collision radius of cylinders
+	float const collision_radius = 0.15f; //collision radius of balls and dozers (in scene files without tags)
+	float const score_collision_radius = 0.4f; //collision radius of cylinders (in scene files without tags)
 
 
 	//The only things constant in this world
@@ -211,42 +441,90 @@ int main(int argc, char **argv) {
 	float friction = 0.9f;
 
 
-	{ //read objects to add from "scene.blob":
-		std::ifstream file("scene.blob", std::ios::binary);
-
-		std::vector< char > strings;
-		//read strings chunk:
-		read_chunk(file, "str0", &strings);
-
-		{ //read scene chunk, add meshes to scene:
-			struct SceneEntry {
-				uint32_t name_begin, name_end;
-				glm::vec3 position;
-				glm::quat rotation;
-				glm::vec3 scale;
+	//add objects from a scene blob (once the loader has read it):
+	bool scene_loaded = false;
+	auto add_scene = [&](SceneBlob const &blob) {
+		std::vector< char > const &strings = blob.strings;
+		std::vector< SceneBlob::Entry > const &data = blob.entries;
+
+		//per-entry gameplay info (parallel to scn0; see 'tag0' in export-pool-meshes.py):
+		enum ObjectType : uint32_t {
+			PropType = 0,
+			BallType = 1,
+			DozerType = 2,
+			PocketType = 3,
+		};
+		enum ObjectFlags : uint32_t {
+			DynamicFlag = 0x1,
+		};
+		typedef SceneBlob::Tag SceneTag;
+
+		std::vector< SceneTag > tags = blob.tags;
+		if (tags.empty() && !data.empty()) { //older scene files: fall back to classifying by name
+			std::cerr << "NOTE: scene file has no tag0 chunk; classifying objects by name." << std::endl;
+			auto name_has = [](char const *begin, char const *end, std::string const &part) {
+				return std::search(begin, end, part.begin(), part.end()) != end;
 			};
-			static_assert(sizeof(SceneEntry) == 48, "Scene entry should be packed");
-
-			std::vector< SceneEntry > data;
-			read_chunk(file, "scn0", &data);
-
+			tags.reserve(data.size());
 			for (auto const &entry : data) {
-				if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
-					throw std::runtime_error("index entry has out-of-range name begin/end");
-				}
-				std::string name(&strings[0] + entry.name_begin, &strings[0] + entry.name_end);
-				//place objects in the background
-				if (object_is_cylinder(name))
-					cylinder_object_list.emplace_back( &add_object(name, entry.position, entry.rotation, entry.scale));
-				else if (object_is_ball(name))
-					ball_object_list.emplace_back( &add_object(name, entry.position, entry.rotation, entry.scale));
-				else if (object_is_dozer(name))
-					dozer_object_list.emplace_back( &add_object(name, entry.position, entry.rotation, entry.scale));
-				else
-					add_object(name, entry.position, entry.rotation, entry.scale);
+				char const *name_begin = strings.data() + entry.name_begin;
+				char const *name_end = strings.data() + entry.name_end;
+				SceneTag tag{PropType, 0.0f, 0};
+				if (name_has(name_begin, name_end, "Cylinder")) tag = SceneTag{PocketType, score_collision_radius, 0};
+				else if (name_has(name_begin, name_end, "Ball")) tag = SceneTag{BallType, collision_radius, DynamicFlag};
+				else if (name_has(name_begin, name_end, "Circle")) tag = SceneTag{DozerType, collision_radius, DynamicFlag};
+				tags.emplace_back(tag);
 			}
 		}
-	}
+
+		//size per-type lists up front:
+		uint32_t type_counts[4] = {0, 0, 0, 0};
+		for (auto const &tag : tags) {
+			if (tag.type < 4) type_counts[tag.type] += 1;
+		}
+		ball_object_list.reserve(type_counts[BallType]);
+		dozer_object_list.reserve(type_counts[DozerType]);
+		cylinder_object_list.reserve(type_counts[PocketType]);
+		ball_radius.reserve(type_counts[BallType]);
+		dozer_radius.reserve(type_counts[DozerType]);
+		cylinder_radius.reserve(type_counts[PocketType]);
+
+		for (uint32_t i = 0; i < data.size(); ++i) {
+			SceneBlob::Entry const &entry = data[i];
+			SceneTag const &tag = tags[i];
+			char const *name_begin = strings.data() + entry.name_begin;
+			char const *name_end = strings.data() + entry.name_end;
+			MeshID id = mesh_id(name_begin, name_end);
+			Scene::Object *object;
+			if (tag.type == BallType) {
+				//balls share one sphere (see 'shared_ball' in export-pool-meshes.py), numbered by a layer of ball_faces:
+				// (layer from the number after the last '-' in the name, e.g. "Ball-9" -> 8)
+				uint32_t number = 0;
+				char const *dash = name_end;
+				while (dash != name_begin && dash[-1] != '-') --dash;
+				for (char const *c = dash; c != name_end && *c >= '0' && *c <= '9'; ++c) {
+					number = number * 10 + uint32_t(*c - '0');
+				}
+				GLuint texture = 0;
+				if (ball_faces && number >= 1 && number <= ball_faces->layers) texture = ball_faces->texture;
+				object = &add_object(id, entry.position, entry.rotation, entry.scale, texture, (number ? number - 1 : 0), true);
+			} else {
+				object = &add_object(id, entry.position, entry.rotation, entry.scale);
+			}
+			//place objects in the background
+			if (tag.type == PocketType) {
+				cylinder_object_list.emplace_back(object);
+				cylinder_radius.emplace_back(tag.radius);
+			} else if (tag.type == BallType) {
+				ball_object_list.emplace_back(object);
+				ball_radius.emplace_back(tag.radius);
+			} else if (tag.type == DozerType) {
+				dozer_object_list.emplace_back(object);
+				dozer_radius.emplace_back(tag.radius);
+			}
+		}
+		scene_loaded = true;
+	};
 
 	glm::vec2 mouse = glm::vec2(0.0f, 0.0f); //mouse position in [-1,1]x[-1,1] coordinates
 
@@ -260,9 +538,21 @@ int main(int argc, char **argv) {
 	//------------ game loop ------------
 
 	bool should_quit = false;
+	bool fully_streamed = false; //scene and every mesh it uses are on the GPU
+	//headless benchmark (see config.frames):
+	bool timing = false;
+	uint32_t timed_frames = 0;
+	std::chrono::high_resolution_clock::time_point timed_start;
+	DebugOutput::Counts timed_messages; //(debug output during the timed frames)
+	int exit_code = 0;
+	auto stats_printed = std::chrono::high_resolution_clock::now();
+	std::vector< std::string > message_counters; //(frame stats names for each type of debug message)
+	for (uint32_t t = 0; t < DebugOutput::TypeCount; ++t) {
+		message_counters.emplace_back(std::string("GL ") + DebugOutput::type_name(t));
+	}
 	while (true) {
 		static SDL_Event evt;
-		while (SDL_PollEvent(&evt) == 1) {
+		while (!config.headless && SDL_PollEvent(&evt) == 1) {
 			//handle input:
 			if (evt.type == SDL_MOUSEMOTION) {
 				glm::vec2 old_mouse = mouse;
@@ -277,6 +567,27 @@ int main(int argc, char **argv) {
 				//Uint8 *keystate = SDL_GetKeyState(NULL);
 				if (evt.key.keysym.sym == SDLK_ESCAPE)
 					should_quit = true;
+				if (evt.key.keysym.sym == SDLK_F12) {
+					screenshot_requested = true;
+				}
+				if (evt.key.keysym.sym == SDLK_F11) {
+					if (capture.recording()) {
+						capture.end_sequence();
+					} else {
+						char name[32];
+						snprintf(name, sizeof(name), (config.record_raw ? "replay-%02u.raw" : "replay-%02u"), sequences);
+						start_recording(name);
+						sequences += 1;
+					}
+				}
+				if (evt.key.keysym.sym == SDLK_F2) {
+					scene.depth_prepass = !scene.depth_prepass;
+					std::cout << "Depth pre-pass " << (scene.depth_prepass ? "on" : "off") << "." << std::endl;
+				}
+				if (evt.key.keysym.sym == SDLK_F3) {
+					config.stats = !config.stats;
+					std::cout << "Frame stats " << (config.stats ? "on" : "off") << "." << std::endl;
+				}
 
 				//Button Inputs
 
@@ -342,12 +653,57 @@ int main(int argc, char **argv) {
 		}
 		if (should_quit) break;
 
+		timers->begin_frame();
+
 		auto current_time = std::chrono::high_resolution_clock::now();
 		static auto previous_time = current_time;
 		float elapsed = std::chrono::duration< float >(current_time - previous_time).count();
 		previous_time = current_time;
 
-		{ //update game state:
+		timers->begin("streaming");
+		{ //bring in whatever the loader thread has finished reading:
+			SceneBlob blob;
+			if (loader.pop_scene(&blob)) add_scene(blob);
+
+			//pass read meshes on to the upload thread:
+			StagedMesh staged;
+			while (uploader.can_push() && loader.pop_mesh(&staged)) {
+				uploader.push(std::move(staged));
+			}
+
+			//add finished uploads (copied into the arena on the GPU), up to about config.upload_budget bytes per frame:
+			size_t uploaded = 0;
+			uint32_t added = 0;
+			UploadedMesh mesh;
+			while (uploaded < config.upload_budget && uploader.pop(&mesh)) {
+				meshes.add_uploaded(mesh, attributes);
+				uploaded += mesh.vertices * (sizeof(v3n3) + sizeof(c4ub) + sizeof(t2f)); //(zero for aliases)
+				added += 1;
+			}
+
+			//point waiting objects at meshes that just arrived:
+			if (added) {
+				auto still_waiting = std::remove_if(waiting_objects.begin(), waiting_objects.end(), [&](std::pair< Scene::Object *, MeshID > const &w) {
+					Mesh const *mesh = meshes.find(w.second);
+					if (mesh) set_mesh(*w.first, *mesh);
+					return mesh != nullptr;
+				});
+				waiting_objects.erase(still_waiting, waiting_objects.end());
+			}
+			if (!waiting_objects.empty() && loader.done() && uploader.idle()) {
+				throw std::runtime_error("Looking up mesh that doesn't exist.");
+			}
+			if (!fully_streamed && scene_loaded && waiting_objects.empty() && loader.done() && uploader.idle()) {
+				timeline_mark("scene fully streamed in");
+				timeline_report(std::cout);
+				fully_streamed = true;
+				if (!config.record.empty()) start_recording(config.record);
+			}
+		}
+		timers->end();
+
+		timers->begin("update");
+		if (scene_loaded) { //update game state:
 
 			//Update Dozer positions
 			for (uint32_t i = 0; i < 2; i++) {
@@ -428,11 +784,11 @@ int main(int argc, char **argv) {
 			//Update Ball positions
 
 			//Collision between dozer and ball
-			auto dozer_collision = [&](Scene::Object *dozer, Scene::Object *ball) {
+			auto dozer_collision = [&](Scene::Object *dozer, float dozer_r, Scene::Object *ball, float ball_r) {
 				//find distance
 				float distance = std::sqrt(std::pow(ball->transform.position.x - dozer->transform.position.x, 2)
 								 + std::pow(ball->transform.position.y - dozer->transform.position.y, 2));
-				if (distance <= (2.0f * collision_radius)) {
+				if (distance <= (dozer_r + ball_r)) {
 					glm::vec3 a_to_b = ball->transform.position - dozer->transform.position;
 					glm::vec3 norm_ab = std::sqrt(std::pow(a_to_b.x, 2) + 
 												  std::pow(a_to_b.y, 2) + 
@@ -443,11 +799,11 @@ int main(int argc, char **argv) {
 			};
 
 			//Elastic sphere collision
-			auto sphere_collision = [&](Scene::Object *ball_1, Scene::Object *ball_2) {
+			auto sphere_collision = [&](Scene::Object *ball_1, float ball_1_r, Scene::Object *ball_2, float ball_2_r) {
 				//find distance
 				float distance = std::sqrt(std::pow(ball_2->transform.position.x - ball_1->transform.position.x, 2)
 								 + std::pow(ball_2->transform.position.y - ball_1->transform.position.y, 2));
-				if (distance <= (2.0f * collision_radius)) {
+				if (distance <= (ball_1_r + ball_2_r)) {
 					glm::vec3 a_to_b = ball_2->transform.position - ball_1->transform.position;
 					glm::vec3 norm_ab = std::sqrt(std::pow(a_to_b.x, 2) + 
 												  std::pow(a_to_b.y, 2) + 
@@ -460,11 +816,11 @@ int main(int argc, char **argv) {
 				}
 			};
 
-			auto goal_collision = [&](Scene::Object *goal, Scene::Object *ball) {
+			auto goal_collision = [&](Scene::Object *goal, float goal_r, Scene::Object *ball, float ball_r) {
 
 				float distance = std::sqrt(std::pow(ball->transform.position.x - goal->transform.position.x, 2)
 								 + std::pow(ball->transform.position.y - goal->transform.position.y, 2));
-				if (distance <= (collision_radius + score_collision_radius)) {
+				if (distance <= (ball_r + goal_r)) {
 					return true;
 				}
 				return false;
@@ -487,12 +843,12 @@ int main(int argc, char **argv) {
 			for (uint32_t i = 0; i < ball_object_list.size(); i++) {
 				for (uint32_t j = 0; j < dozer_object_list.size(); j++) {
 					//Dozer Collisions with Ball
-					dozer_collision(dozer_object_list[j], ball_object_list[i]);
+					dozer_collision(dozer_object_list[j], dozer_radius[j], ball_object_list[i], ball_radius[i]);
 					border_collision(dozer_object_list[j]);
 					
 				}
 				for (uint32_t j = 0; j < cylinder_object_list.size(); j++) {
-					if (goal_collision(cylinder_object_list[j], ball_object_list[i])) {
+					if (goal_collision(cylinder_object_list[j], cylinder_radius[j], ball_object_list[i], ball_radius[i])) {
 						index_delete = i;
 					}
 				}
@@ -513,7 +869,7 @@ int main(int argc, char **argv) {
 						);
 				}
 				//Constantly apply gravity
-				if (ball_object_list[i]->transform.position.z >= (0.001f + collision_radius)) {
+				if (ball_object_list[i]->transform.position.z >= (0.001f + ball_radius[i])) {
 					ball_object_list[i]->transform.position.z -= gravity;
 				}
 				else {
@@ -529,11 +885,11 @@ int main(int argc, char **argv) {
 			//Ball collisions with Ball
 			for (uint32_t i = 0; i < ball_object_list.size(); i++) {
 				for (uint32_t j = 0; j < ball_object_list.size(); j++) {
-					sphere_collision(ball_object_list[i], ball_object_list[j]);
+					sphere_collision(ball_object_list[i], ball_radius[i], ball_object_list[j], ball_radius[j]);
 				}
 				//Ball collisions with sides
 				for (uint32_t j = 0; j < cylinder_object_list.size(); j++) {
-					if (goal_collision(cylinder_object_list[j], ball_object_list[i])) {
+					if (goal_collision(cylinder_object_list[j], cylinder_radius[j], ball_object_list[i], ball_radius[i])) {
 						index_delete = i;
 					}
 				}
@@ -564,77 +920,126 @@ int main(int argc, char **argv) {
 			);
 			scene.camera.transform.scale = glm::vec3(1.0f, 1.0f, 1.0f);
 		}
+		timers->end();
 
 		//draw output:
-		glClearColor(0.5, 0.5, 0.5, 0.0);
+		timers->begin("render");
+		timers->begin("clear");
+		glClearColor(0.5, 0.5, 0.5, 1.0); //(opaque alpha, so captured frames aren't see-through)
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		timers->end();
+		//(blending is only enabled by scene.render() for its transparent pass)
 
 
-		{ //draw game state:
-			glUseProgram(program);
-			glUniform3fv(program_to_light, 1, glm::value_ptr(glm::normalize(glm::vec3(0.0f, 1.0f, 10.0f))));
+		{ //draw game state (scene.render() times each of its passes):
+			FrameTimers::Scope draw(timers.get(), "scene");
+			for (auto const &variant : shaders.variants) {
+				if (variant.program == 0 || variant.to_light == -1U) continue;
+				glUseProgram(variant.program);
+				glUniform3fv(variant.to_light, 1, glm::value_ptr(glm::normalize(glm::vec3(0.0f, 1.0f, 10.0f))));
+			}
 			scene.render();
 		}
 
+		timers->begin("capture");
+		if (screenshot_requested) {
+			char name[32];
+			snprintf(name, sizeof(name), "screenshot-%04u.png", screenshots);
+			if (capture.capture(name)) {
+				std::cout << "Saving '" << name << "'." << std::endl;
+				screenshots += 1;
+			} else {
+				std::cerr << "NOTE: still saving earlier screenshots; skipped this one." << std::endl;
+			}
+			screenshot_requested = false;
+		}
+		if (capture.recording() && !capture.capture_sequence()) {
+			capture.end_sequence(); //(hit config.record_frames)
+		}
+		capture.update();
+		timers->end();
+		timers->end(); //(render)
+
+		DebugOutput::Counts frame_messages = debug->end_frame();
+		if (timing) timed_messages += frame_messages;
+		if (debug->active) { //(part of the frame stats, too)
+			for (uint32_t t = 0; t < DebugOutput::TypeCount; ++t) {
+				timers->count(message_counters[t].c_str(), frame_messages.by_type[t]);
+			}
+		}
 
-		SDL_GL_SwapWindow(window);
-	}
-
+		timers->end_frame();
+		if (config.stats && !config.headless && current_time - stats_printed > std::chrono::seconds(1)) {
+			timers->report(std::cout);
+			stats_printed = current_time;
+		}
 
-	//------------  teardown ------------
+		if (!config.headless) {
+			SDL_GL_SwapWindow(window);
+		} else if (fully_streamed) { //time frames drawn once everything is in (waiting for the GPU at each end):
+			if (!timing) {
+				glFinish(); //(the frame that finished streaming isn't counted)
+				timed_start = std::chrono::high_resolution_clock::now();
+				timing = true;
+			} else if (++timed_frames == config.frames) {
+				glFinish();
+				float ms = std::chrono::duration< float, std::milli >(std::chrono::high_resolution_clock::now() - timed_start).count();
+				std::cout << "Rendered " << timed_frames << " frames at " << config.size.x << "x" << config.size.y
+					<< " in " << ms << "ms (" << ms / timed_frames << "ms per frame, " << 1000.0f * timed_frames / ms << " fps)." << std::endl;
+				timers->finish(); //(the GPU is done, so nothing is still in flight)
+				timers->report(std::cout);
+				if (debug->active) {
+					std::cout << "OpenGL debug output while timing:";
+					for (uint32_t t = 0; t < DebugOutput::TypeCount; ++t) {
+						std::cout << " " << timed_messages.by_type[t] << " " << DebugOutput::type_name(t) << (t + 1 < DebugOutput::TypeCount ? "," : ".");
+					}
+					std::cout << std::endl;
+				}
+				if (config.strict_gl && timed_messages.problems()) {
+					std::cerr << "ERROR: the driver reported " << timed_messages.problems() << " errors or performance problems while timing (--strict-gl)." << std::endl;
+					exit_code = 2;
+				}
+				if (config.strict_gl && !debug->active) {
+					std::cerr << "WARNING: --strict-gl has nothing to check; this context has no debug output." << std::endl;
+				}
+				capture.end_sequence(); //(if recording)
+				if (!config.output.empty()) {
+					capture.capture(config.output); //(a buffer is free: nothing else captures in headless mode)
+					capture.finish();
+					std::cout << "Wrote '" << config.output << "'." << std::endl;
+				}
+				break;
+			}
+		}
 
-	SDL_GL_DeleteContext(context);
-	context = 0;
+		static bool first_frame = true;
+		if (first_frame) {
+			timeline_mark("first frame swapped");
+			first_frame = false;
+		}
+	}
 
-	SDL_DestroyWindow(window);
-	window = NULL;
 
-	return 0;
-}
+	//------------  teardown ------------
 
+	uploader.stop(); //(its context goes with the window)
+	debug.reset(); //(prints a summary; needs the context)
+	timers.reset(); //(needs the context)
+	scene.timers = nullptr;
+	capture.stop(); //(finishes saving screenshots)
+	ball_faces.reset(); //(needs the context)
 
+	if (headless) {
+		offscreen.reset(); //(needs the context, so goes first)
+		headless.reset();
+	} else {
+		SDL_GL_DeleteContext(context);
+		context = 0;
 
-static GLuint compile_shader(GLenum type, std::string const &source) {
-	GLuint shader = glCreateShader(type);
-	GLchar const *str = source.c_str();
-	GLint length = source.size();
-	glShaderSource(shader, 1, &str, &length);
-	glCompileShader(shader);
-	GLint compile_status = GL_FALSE;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
-	if (compile_status != GL_TRUE) {
-		std::cerr << "Failed to compile shader." << std::endl;
-		GLint info_log_length = 0;
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_log_length);
-		std::vector< GLchar > info_log(info_log_length, 0);
-		GLsizei length = 0;
-		glGetShaderInfoLog(shader, info_log.size(), &length, &info_log[0]);
-		std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
-		glDeleteShader(shader);
-		throw std::runtime_error("Failed to compile shader.");
+		SDL_DestroyWindow(window);
+		window = NULL;
 	}
-	return shader;
-}
 
-static GLuint link_program(GLuint fragment_shader, GLuint vertex_shader) {
-	GLuint program = glCreateProgram();
-	glAttachShader(program, vertex_shader);
-	glAttachShader(program, fragment_shader);
-	glLinkProgram(program);
-	GLint link_status = GL_FALSE;
-	glGetProgramiv(program, GL_LINK_STATUS, &link_status);
-	if (link_status != GL_TRUE) {
-		std::cerr << "Failed to link shader program." << std::endl;
-		GLint info_log_length = 0;
-		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &info_log_length);
-		std::vector< GLchar > info_log(info_log_length, 0);
-		GLsizei length = 0;
-		glGetProgramInfoLog(program, info_log.size(), &length, &info_log[0]);
-		std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
-		throw std::runtime_error("Failed to link program");
-	}
-	return program;
+	return exit_code;
 }
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <type_traits>
+
+//MeshID is a 64-bit FNV-1a hash of a mesh's name.
+// export scripts write these into the 'id64' chunk of mesh blobs, so
+// looking up a mesh never needs to touch (or allocate) a string.
+typedef uint64_t MeshID;
+
+constexpr MeshID mesh_id_step(char const *name, MeshID hash) {
+	return *name ? mesh_id_step(name + 1, (hash ^ uint8_t(*name)) * 0x100000001b3ULL) : hash;
+}
+
+//hash of a null-terminated name:
+constexpr MeshID mesh_id(char const *name) {
+	return mesh_id_step(name, 0xcbf29ce484222325ULL);
+}
+
+//hash of the name in [begin,end) (e.g., a range in a 'str0' chunk):
+inline MeshID mesh_id(char const *begin, char const *end) {
+	MeshID hash = 0xcbf29ce484222325ULL;
+	for (char const *c = begin; c != end; ++c) {
+		hash = (hash ^ uint8_t(*c)) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+//MESH_ID("Ball-1") is always evaluated at compile time:
+#define MESH_ID(NAME) (std::integral_constant< MeshID, mesh_id(NAME) >::value)
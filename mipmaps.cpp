@@ -0,0 +1,210 @@
+#include "mipmaps.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIPMAPS_SSE2
+#endif
+
+uint32_t mip_levels(uint32_t width, uint32_t height) {
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+		levels += 1;
+	}
+	return levels;
+}
+
+static float srgb_to_linear(float v) {
+	return (v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f));
+}
+
+static float linear_to_srgb(float v) {
+	return (v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f);
+}
+
+//Images are filtered as four floats per pixel -- color in [0,3), alpha in [3] --
+// with color premultiplied by alpha.
+
+//which source pixels (and how much of each) make up each destination pixel along one axis:
+struct Taps {
+	uint32_t count = 0; //per destination pixel (unused taps have zero weight)
+	std::vector< uint32_t > index; //count per destination pixel
+	std::vector< float > weight;
+};
+
+static double bessel_i0(double x) {
+	double sum = 1.0, term = 1.0;
+	for (uint32_t k = 1; k < 32; ++k) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+static Taps make_taps(uint32_t src, uint32_t dst, MipOptions::Filter filter, bool wrap) {
+	double scale = double(src) / double(dst); //(2, or a bit more for odd sizes)
+	//how far (in source pixels) from a destination pixel's center its filter reaches:
+	double radius = (filter == MipOptions::Box ? 0.5 * scale : 2.0 * scale);
+	Taps taps;
+	taps.count = uint32_t(std::ceil(2.0 * radius)) + 1;
+	taps.index.resize(dst * taps.count, 0);
+	taps.weight.resize(dst * taps.count, 0.0f);
+	double const beta = 4.0;
+	double const Pi = 3.14159265358979323846; //(M_PI isn't standard; MSVC only has it with _USE_MATH_DEFINES)
+	for (uint32_t d = 0; d < dst; ++d) {
+		double center = (d + 0.5) * scale;
+		int32_t first = int32_t(std::floor(center - radius));
+		double total = 0.0;
+		std::vector< double > weights(taps.count, 0.0);
+		for (uint32_t t = 0; t < taps.count; ++t) {
+			int32_t s = first + int32_t(t);
+			double w;
+			if (filter == MipOptions::Box) {
+				//how much of source pixel s is inside the destination pixel:
+				w = std::max(0.0, std::min(s + 1.0, center + radius) - std::max(double(s), center - radius));
+			} else {
+				double x = (s + 0.5 - center) / scale; //(in destination pixels)
+				double r = (s + 0.5 - center) / radius;
+				if (std::abs(r) >= 1.0) {
+					w = 0.0;
+				} else {
+					double sinc = (x == 0.0 ? 1.0 : std::sin(Pi * x) / (Pi * x));
+					w = sinc * bessel_i0(beta * std::sqrt(1.0 - r * r)) / bessel_i0(beta);
+				}
+			}
+			//edges either wrap around or repeat the edge pixel:
+			if (wrap) s = ((s % int32_t(src)) + int32_t(src)) % int32_t(src);
+			else s = std::max(0, std::min(int32_t(src) - 1, s));
+			taps.index[d * taps.count + t] = uint32_t(s);
+			weights[t] = w;
+			total += w;
+		}
+		assert(total > 0.0);
+		for (uint32_t t = 0; t < taps.count; ++t) {
+			taps.weight[d * taps.count + t] = float(weights[t] / total);
+		}
+	}
+	return taps;
+}
+
+//filter 'src' along one axis, where pixel (i along the axis, j across it) is at src[4 * (i * along + j * across)]:
+// (called once for rows, with along = 1, and once for columns)
+static void filter_axis(float const *src, size_t src_along, size_t src_across,
+	float *dst, size_t dst_along, size_t dst_across,
+	uint32_t dst_count, uint32_t across_count, Taps const &taps) {
+	for (uint32_t j = 0; j < across_count; ++j) {
+		float const *src_line = src + 4 * j * src_across;
+		float *dst_line = dst + 4 * j * dst_across;
+		for (uint32_t i = 0; i < dst_count; ++i) {
+			uint32_t const *index = &taps.index[i * taps.count];
+			float const *weight = &taps.weight[i * taps.count];
+#ifdef MIPMAPS_SSE2
+			__m128 sum = _mm_setzero_ps();
+			for (uint32_t t = 0; t < taps.count; ++t) {
+				__m128 pixel = _mm_loadu_ps(src_line + 4 * index[t] * src_along);
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weight[t]), pixel));
+			}
+			_mm_storeu_ps(dst_line + 4 * i * dst_along, sum);
+#else
+			float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+			for (uint32_t t = 0; t < taps.count; ++t) {
+				float const *pixel = src_line + 4 * index[t] * src_along;
+				for (uint32_t c = 0; c < 4; ++c) {
+					sum[c] += weight[t] * pixel[c];
+				}
+			}
+			std::memcpy(dst_line + 4 * i * dst_along, sum, sizeof(sum));
+#endif
+		}
+	}
+}
+
+std::vector< std::vector< uint8_t > > make_mipmaps(uint32_t width, uint32_t height, uint32_t channels, uint32_t bit_depth, std::vector< uint8_t > const &pixels, MipOptions const &options) {
+	if (channels < 1 || channels > 4 || (bit_depth != 8 && bit_depth != 16)) {
+		throw std::runtime_error("Can only make mipmaps of 1-4 channel, 8- or 16-bit images.");
+	}
+	if (width == 0 || height == 0 || pixels.size() != size_t(width) * height * channels * (bit_depth / 8)) {
+		throw std::runtime_error("Image size doesn't match its pixel data.");
+	}
+	uint32_t colors = (channels >= 3 ? 3 : 1);
+	bool alpha = (channels == 2 || channels == 4);
+	float max_value = float((1U << bit_depth) - 1);
+
+	auto value = [&](uint32_t i) -> float {
+		if (bit_depth == 8) return pixels[i];
+		uint16_t v;
+		std::memcpy(&v, &pixels[2 * i], 2);
+		return v;
+	};
+	//(8-bit sRGB decodes through a table; 16-bit images, which are rare, don't bother)
+	float decode8[256];
+	for (uint32_t v = 0; v < 256; ++v) {
+		decode8[v] = (options.srgb ? srgb_to_linear(v / 255.0f) : v / 255.0f);
+	}
+
+	//level 0 to linear, premultiplied floats:
+	std::vector< float > level(size_t(width) * height * 4, 0.0f);
+	for (size_t p = 0; p < size_t(width) * height; ++p) {
+		float *out = &level[4 * p];
+		out[3] = (alpha ? value(uint32_t(p * channels + channels - 1)) / max_value : 1.0f);
+		for (uint32_t c = 0; c < colors; ++c) {
+			uint32_t i = uint32_t(p * channels + c);
+			float v = (bit_depth == 8 ? decode8[pixels[i]] : (options.srgb ? srgb_to_linear(value(i) / max_value) : value(i) / max_value));
+			out[c] = v * out[3];
+		}
+	}
+
+	std::vector< std::vector< uint8_t > > levels;
+	levels.emplace_back(pixels);
+
+	std::vector< float > rows, next;
+	uint32_t w = width, h = height;
+	while (w > 1 || h > 1) {
+		uint32_t nw = std::max(1U, w / 2), nh = std::max(1U, h / 2);
+
+		//filter rows (w x h -> nw x h), then columns (nw x h -> nw x nh):
+		rows.resize(size_t(nw) * h * 4);
+		if (nw == w) rows = level;
+		else filter_axis(level.data(), 1, w, rows.data(), 1, nw, nw, h, make_taps(w, nw, options.filter, options.wrap_x));
+		next.resize(size_t(nw) * nh * 4);
+		if (nh == h) next = rows;
+		else filter_axis(rows.data(), nw, 1, next.data(), nw, 1, nh, nw, make_taps(h, nh, options.filter, options.wrap_y));
+
+		//quantize to the source layout:
+		std::vector< uint8_t > out(size_t(nw) * nh * channels * (bit_depth / 8));
+		for (size_t p = 0; p < size_t(nw) * nh; ++p) {
+			float const *in = &next[4 * p];
+			float a = std::max(0.0f, std::min(1.0f, in[3]));
+			for (uint32_t c = 0; c < channels; ++c) {
+				float v;
+				if (alpha && c == channels - 1) {
+					v = a;
+				} else {
+					v = (in[3] > 0.0f ? in[c < colors ? c : 0] / in[3] : 0.0f);
+					v = std::max(0.0f, std::min(1.0f, v));
+					if (options.srgb) v = linear_to_srgb(v);
+				}
+				uint32_t q = uint32_t(v * max_value + 0.5f);
+				size_t i = p * channels + c;
+				if (bit_depth == 8) {
+					out[i] = uint8_t(q);
+				} else {
+					uint16_t q16 = uint16_t(q);
+					std::memcpy(&out[2 * i], &q16, 2);
+				}
+			}
+		}
+		levels.emplace_back(std::move(out));
+
+		level.swap(next);
+		w = nw;
+		h = nh;
+	}
+	assert(levels.size() == mip_levels(width, height));
+	return levels;
+}
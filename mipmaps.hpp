@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+//Mip chain generation for compile_textures (done offline, so the game only
+// uploads levels; see TextureArray):
+// - color channels are filtered in linear light (decoded from sRGB unless
+//   'srgb' is off) and weighted by alpha, so mips don't darken, and the color
+//   of fully transparent texels doesn't bleed in;
+// - each level is filtered from the (unquantized) level above it, with a 2x2
+//   box or a wider Kaiser-windowed sinc, which keeps more detail (its slight
+//   ringing is clamped away); all four channels of a pixel are filtered at
+//   once, with SSE2 where available.
+
+struct MipOptions {
+	enum Filter {
+		Box, //average 2x2 blocks
+		Kaiser, //sinc windowed by a Kaiser window (beta = 4), 8 taps wide per axis
+	} filter = Kaiser;
+	bool srgb = true; //color channels are sRGB-encoded (alpha never is)
+	bool wrap_x = false; //filter across the left/right edges (for textures that repeat) rather than clamping
+	bool wrap_y = false; //same, for the top/bottom edges
+};
+
+//number of levels in a full chain (down to 1x1):
+uint32_t mip_levels(uint32_t width, uint32_t height);
+
+//build every level of an image with 'channels' (1-4; 2 is gray + alpha) channels of 'bit_depth'
+// (8 or 16, native byte order) bits, rows tightly packed (as load_png's PNGLayout describes):
+// returns one image per level, in the same layout, starting with (a copy of) 'pixels' itself;
+// level l is max(1, width >> l) by max(1, height >> l) (odd sizes are filtered by area, so no row or column is dropped).
+std::vector< std::vector< uint8_t > > make_mipmaps(uint32_t width, uint32_t height, uint32_t channels, uint32_t bit_depth, std::vector< uint8_t > const &pixels, MipOptions const &options);
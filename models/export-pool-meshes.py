@@ -47,6 +47,13 @@ to_write = [
 
 ]
 
+#64-bit FNV-1a hash of a mesh name (must match mesh_id() in mesh_id.hpp):
+def mesh_id(name):
+	h = 0xcbf29ce484222325
+	for b in bytes(name, "utf8"):
+		h = ((h ^ b) * 0x100000001b3) & 0xffffffffffffffff
+	return h
+
 #data contains vertex and normal data from the meshes:
 data = b''
 
@@ -56,11 +63,33 @@ strings = b''
 #index gives offsets into the data (and names) for each mesh:
 index = b''
 
-#color contains vertex color data from the meshes:
+#ids gives the hashed name of each mesh (parallel to index):
+ids = b''
+
+#colors contains vertex color data from the meshes (parallel to data):
 data_colors = b''
 
+#texcoords contains texture coordinates from the meshes' active uv layers (parallel to data):
+data_texcoords = b''
+
+#balls get their color (and number) from a layer of the ball texture array, so they all
+# share the first ball's (white) sphere -- (start, count) of its vertices, once written:
+shared_ball = None
+
 vertex_count = 0
 for name in to_write:
+	if name.startswith('Ball') and shared_ball is not None:
+		print("Writing '" + name + "' (sharing the first ball's vertices)...")
+		name_begin = len(strings)
+		strings += bytes(name, "utf8")
+		name_end = len(strings)
+		index += struct.pack('I', name_begin)
+		index += struct.pack('I', name_end)
+		ids += struct.pack('Q', mesh_id(name))
+		index += struct.pack('I', shared_ball[0])
+		index += struct.pack('I', shared_ball[1])
+		continue
+
 	print("Writing '" + name + "'...")
 	bpy.ops.object.mode_set(mode='OBJECT') #get out of edit mode (just in case)
 	assert(name in bpy.data.objects)
@@ -89,6 +118,10 @@ for name in to_write:
 	if mesh.vertex_colors.active is None:
 		bpy.ops.mesh.vertex_color_add()
 	colors = mesh.vertex_colors.active.data
+	uvs = mesh.uv_layers.active.data if mesh.uv_layers.active is not None else None
+	white = name.startswith('Ball')
+	if white:
+		shared_ball = (vertex_count, len(mesh.polygons) * 3)
 
 	#record mesh name, start position and vertex count in the index:
 	name_begin = len(strings)
@@ -96,6 +129,7 @@ for name in to_write:
 	name_end = len(strings)
 	index += struct.pack('I', name_begin)
 	index += struct.pack('I', name_end)
+	ids += struct.pack('Q', mesh_id(name))
 
 	index += struct.pack('I', vertex_count)
 	index += struct.pack('I', len(mesh.polygons) * 3)
@@ -112,15 +146,24 @@ for name in to_write:
 				data += struct.pack('f', x)
 			for x in loop.normal:
 				data += struct.pack('f', x)
-			data_colors += struct.pack('BBBB',
-				int(color.r * 255),
-				int(color.g * 255),
-				int(color.b * 255),
-				255)
+			if white:
+				data_colors += struct.pack('BBBB', 255, 255, 255, 255)
+			else:
+				data_colors += struct.pack('BBBB',
+					int(color.r * 255),
+					int(color.g * 255),
+					int(color.b * 255),
+					255)
+			if uvs is not None:
+				data_texcoords += struct.pack('ff', uvs[poly.loop_indices[i]].uv.x, uvs[poly.loop_indices[i]].uv.y)
+			else:
+				data_texcoords += struct.pack('ff', 0.0, 0.0)
 	vertex_count += len(mesh.polygons) * 3
 
 #check that we wrote as much data as anticipated:
 assert(vertex_count * (3 * 4 + 3 * 4) == len(data))
+assert(vertex_count * 4 == len(data_colors))
+assert(vertex_count * 2 * 4 == len(data_texcoords))
 
 #write the data chunk and index chunk to an output blob:
 blob = open('../dist/meshes.blob', 'wb')
@@ -136,6 +179,18 @@ blob.write(strings)
 blob.write(struct.pack('4s',b'idx0')) #type
 blob.write(struct.pack('I', len(index))) #length
 blob.write(index)
+#fourth chunk: the hashed names
+blob.write(struct.pack('4s',b'id64')) #type
+blob.write(struct.pack('I', len(ids))) #length
+blob.write(ids)
+#fifth chunk: the vertex colors
+blob.write(struct.pack('4s',b'c4ub')) #type
+blob.write(struct.pack('I', len(data_colors))) #length
+blob.write(data_colors)
+#sixth chunk: the texture coordinates
+blob.write(struct.pack('4s',b't2f0')) #type
+blob.write(struct.pack('I', len(data_texcoords))) #length
+blob.write(data_texcoords)
 
 print("Wrote " + str(blob.tell()) + " bytes to meshes.blob")
 
@@ -156,8 +211,24 @@ for name in to_write:
 	strings += bytes(name, 'utf8')
 	name_end[mesh_name] = len(strings)
 
+#type, collision radius, and flags for an exported object (must match SceneTag in main.cpp):
+PROP, BALL, DOZER, POCKET = 0, 1, 2, 3
+DYNAMIC = 0x1
+#(matches anywhere in the name, as main.cpp's fallback for untagged scene files does)
+def tag_for(name):
+	if 'Cylinder' in name: return (POCKET, 0.4, 0)
+	if 'Ball' in name: return (BALL, 0.15, DYNAMIC)
+	if 'Circle' in name: return (DOZER, 0.15, DYNAMIC)
+	return (PROP, 0.0, 0)
+
+tag_of = dict()
+for name in to_write:
+	tag_of[bpy.data.objects[name].data.name] = tag_for(name)
+
 #scene chunk will have transforms + indices into strings for name
 scene = b''
+#tags chunk has type/radius/flags for each scene entry (parallel to scene):
+tags = b''
 for obj in bpy.data.objects:
 	if obj.layers[0] == False: continue
 	if not obj.data.name in name_begin:
@@ -169,6 +240,7 @@ for obj in bpy.data.objects:
 	scene += struct.pack('3f', transform[0].x, transform[0].y, transform[0].z)
 	scene += struct.pack('4f', transform[1].x, transform[1].y, transform[1].z, transform[1].w)
 	scene += struct.pack('3f', transform[2].x, transform[2].y, transform[2].z)
+	tags += struct.pack('IfI', *tag_of[obj.data.name])
 
 #write the strings chunk and scene chunk to an output blob:
 blob = open('../dist/scene.blob', 'wb')
@@ -180,8 +252,10 @@ blob.write(strings)
 blob.write(struct.pack('4s',b'scn0')) #type
 blob.write(struct.pack('I', len(scene))) #length
 blob.write(scene)
-#colors?
-blob.write(data_colors)
+#third chunk: the tags
+blob.write(struct.pack('4s',b'tag0')) #type
+blob.write(struct.pack('I', len(tags))) #length
+blob.write(tags)
 
 print("Wrote " + str(blob.tell()) + " bytes to scene.blob")
 
@@ -0,0 +1,152 @@
+#!/usr/bin/env python
+
+#Note: Script meant to be executed from within blender, as per:
+#blender --background --python export-pool-obj.py
+
+#reads 'pool.blend' and writes 'pool.obj' (meshes) and 'pool.scene' (scene in layer 1),
+#which pack_assets turns into '../dist/meshes.blob' and '../dist/scene.blob':
+#  ../dist/pack_assets -o ../dist/meshes.blob -s pool.scene ../dist/scene.blob pool.obj
+
+#(output is built as a list of lines and joined once, so export time is linear in mesh size)
+#pass '-c <dir>' to pack_assets to only re-process objects whose dumped text changed.
+
+import sys
+
+import bpy
+
+bpy.ops.wm.open_mainfile(filepath='pool.blend')
+
+#same object list as export-pool-meshes.py:
+to_write = [
+	'Ball-1',
+	'Ball-2',
+	'Ball-3',
+	'Ball-4',
+	'Ball-5',
+	'Ball-6',
+	'Ball-7',
+	'Ball-8',
+	'Ball-9',
+	'Ball-10',
+	'Ball-11',
+	'Ball-12',
+	'Ball-13',
+	'Ball-14',
+	'Ball-15',
+
+	#'Circle',
+	'Circle.001',
+	'Circle.002',
+
+	'Cylinder',
+	'Cylinder.001',
+	'Cylinder.002',
+	'Cylinder.003',
+	'Cylinder.004',
+	'Cylinder.005',
+
+	'Table',
+]
+
+lines = []
+vertex_count = 0
+for name in to_write:
+	print("Writing '" + name + "'...")
+	bpy.ops.object.mode_set(mode='OBJECT') #get out of edit mode (just in case)
+	assert(name in bpy.data.objects)
+	obj = bpy.data.objects[name]
+
+	obj.data = obj.data.copy() #make mesh single user, just in case it is shared with another object the script needs to write later.
+
+	#make sure object is on a visible layer:
+	bpy.context.scene.layers = obj.layers
+	#select the object and make it the active object:
+	bpy.ops.object.select_all(action='DESELECT')
+	obj.select = True
+	bpy.context.scene.objects.active = obj
+
+	#subdivide object's mesh into triangles:
+	bpy.ops.object.mode_set(mode='EDIT')
+	bpy.ops.mesh.select_all(action='SELECT')
+	bpy.ops.mesh.quads_convert_to_tris(quad_method='BEAUTY', ngon_method='BEAUTY')
+	bpy.ops.object.mode_set(mode='OBJECT')
+
+	#compute normals (respecting face smoothing):
+	mesh = obj.data
+	mesh.calc_normals_split()
+
+	if mesh.vertex_colors.active is None:
+		bpy.ops.mesh.vertex_color_add()
+	colors = mesh.vertex_colors.active.data
+	uvs = mesh.uv_layers.active.data if mesh.uv_layers.active is not None else None
+
+	#balls get their color (and number) from a layer of the ball texture array, so their
+	# vertices are left white -- which makes every ball's sphere the same, and pack_assets stores it once:
+	white = name.startswith('Ball')
+
+	#one 'v'/'vt'/'vn' per loop, since colors, texture coordinates, and split normals are per-loop:
+	lines.append("o " + name)
+	for poly in mesh.polygons:
+		assert(len(poly.loop_indices) == 3)
+		for i in poly.loop_indices:
+			loop = mesh.loops[i]
+			co = mesh.vertices[loop.vertex_index].co
+			color = colors[i].color
+			if white:
+				lines.append("v %f %f %f 1 1 1" % (co.x, co.y, co.z))
+			else:
+				lines.append("v %f %f %f %f %f %f" % (co.x, co.y, co.z, color.r, color.g, color.b))
+			if uvs is not None:
+				lines.append("vt %f %f" % (uvs[i].uv.x, uvs[i].uv.y))
+			lines.append("vn %f %f %f" % (loop.normal.x, loop.normal.y, loop.normal.z))
+		#(relative indices keep each object's text independent of the objects before it,
+		# so pack_assets can cache it by content)
+		if uvs is not None:
+			lines.append("f -3/-3/-3 -2/-2/-2 -1/-1/-1")
+		else:
+			lines.append("f -3//-3 -2//-2 -1//-1")
+		vertex_count += 3
+
+with open('pool.obj', 'w') as f:
+	f.write("\n".join(lines))
+	f.write("\n")
+
+print("Wrote " + str(vertex_count) + " vertices to pool.obj")
+
+#---------------------------------------------------------------------
+#Export scene (object positions for every object on layer one)
+
+#(re-open file because we adjusted mesh users in the export above)
+bpy.ops.wm.open_mainfile(filepath='pool.blend')
+
+#type, collision radius, and flags (as in export-pool-meshes.py):
+def tag_for(name):
+	if name.startswith('Cylinder'): return "pocket 0.4"
+	if name.startswith('Ball'): return "ball 0.15 dynamic"
+	if name.startswith('Circle'): return "dozer 0.15 dynamic"
+	return "prop 0"
+
+#map from the *mesh* name of the written objects to the *object* name they are stored under:
+written_name = dict()
+for name in to_write:
+	written_name[bpy.data.objects[name].data.name] = name
+
+lines = []
+for obj in bpy.data.objects:
+	if obj.layers[0] == False: continue
+	if not obj.data.name in written_name:
+		print("WARNING: not writing object '" + obj.name + "' because mesh not written.")
+		continue
+	name = written_name[obj.data.name]
+	transform = obj.matrix_world.decompose()
+	lines.append("%s  %f %f %f  %f %f %f %f  %f %f %f  %s" % (name,
+		transform[0].x, transform[0].y, transform[0].z,
+		transform[1].x, transform[1].y, transform[1].z, transform[1].w,
+		transform[2].x, transform[2].y, transform[2].z,
+		tag_for(name)))
+
+with open('pool.scene', 'w') as f:
+	f.write("\n".join(lines))
+	f.write("\n")
+
+print("Wrote " + str(len(lines)) + " entries to pool.scene")
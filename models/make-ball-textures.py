@@ -0,0 +1,106 @@
+#!/usr/bin/env python
+
+#writes the faces of the pool balls, '../dist/textures/ball-1.png' ... 'ball-15.png',
+#which main.cpp loads as the layers of one texture array (ball N uses layer N-1):
+#  python make-ball-textures.py
+#compile_textures then builds their mip levels ahead of time (repeating around the
+#equator, in s), into '../dist/textures.blob', which main.cpp loads instead if it's there:
+#  cd ../dist && ./compile_textures -o textures.blob -w s ball-faces=textures/ball-{1..15}.png
+
+#each face is an equirectangular map of the whole ball (u around the equator, v from the
+#bottom pole to the top one), as unwrapped by a blender UV sphere's default uvs:
+# - balls 1-8 are solid; 9-15 are white with a colored stripe around the equator;
+# - every ball has its number, in a white disc, on both sides (at u = 0.25 and u = 0.75).
+
+#(plain python -- no PIL -- so it runs anywhere)
+
+import math
+import os
+import struct
+import sys
+import zlib
+
+Width = 256
+Height = 128
+
+#standard ball colors (9-15 repeat 1-7 as stripes):
+Colors = {
+	1: (240, 200, 20), #yellow
+	2: (20, 50, 170), #blue
+	3: (210, 30, 30), #red
+	4: (90, 30, 140), #purple
+	5: (240, 110, 20), #orange
+	6: (20, 120, 50), #green
+	7: (120, 30, 30), #maroon
+	8: (20, 20, 20), #black
+}
+White = (245, 240, 225)
+Ink = (15, 15, 15)
+
+StripeLatitude = math.radians(35.0) #stripe covers the equator to this latitude
+DiscRadius = math.radians(26.0) #angular radius of the number discs
+DigitHeight = math.radians(24.0) #angular height of the number
+
+#3x5 digits, top row first:
+Font = {
+	'0': ['###', '#.#', '#.#', '#.#', '###'],
+	'1': ['.#.', '##.', '.#.', '.#.', '###'],
+	'2': ['###', '..#', '###', '#..', '###'],
+	'3': ['###', '..#', '.##', '..#', '###'],
+	'4': ['#.#', '#.#', '###', '..#', '..#'],
+	'5': ['###', '#..', '###', '..#', '###'],
+	'6': ['###', '#..', '###', '#.#', '###'],
+	'7': ['###', '..#', '.#.', '.#.', '.#.'],
+	'8': ['###', '#.#', '###', '#.#', '###'],
+	'9': ['###', '#.#', '###', '..#', '###'],
+}
+
+def ink(text, x, y):
+	#is (x, y) -- in units of DigitHeight, centered on the text, y up -- on a digit stroke?
+	cell = 1.0 / 5.0
+	columns = 4 * len(text) - 1 #(digits are 3 cells wide, with a one-cell gap)
+	col = int(math.floor(x / cell + 0.5 * columns))
+	row = int(math.floor(-y / cell + 2.5))
+	if row < 0 or row >= 5 or col < 0 or col >= columns: return False
+	if col % 4 == 3: return False
+	return Font[text[col // 4]][row][col % 4] == '#'
+
+def face(number):
+	base = Colors[number if number <= 8 else number - 8]
+	text = str(number)
+	rows = []
+	for j in range(Height):
+		lat = (0.5 - (j + 0.5) / Height) * math.pi #(first row is the top)
+		row = bytearray()
+		for i in range(Width):
+			lon = (i + 0.5) / Width * 2.0 * math.pi
+			if number <= 8 or abs(lat) < StripeLatitude:
+				color = base
+			else:
+				color = White
+			for center in (0.5 * math.pi, 1.5 * math.pi):
+				#(locally flat coordinates around the disc's center, so it stays round on the sphere)
+				x = (lon - center) * math.cos(lat)
+				y = lat
+				if x * x + y * y < DiscRadius * DiscRadius:
+					color = Ink if ink(text, x / DigitHeight, y / DigitHeight) else White
+			row.extend(color)
+		rows.append(bytes(row))
+	return rows
+
+def write_png(filename, rows):
+	def chunk(tag, data):
+		return struct.pack('>I', len(data)) + tag + data + struct.pack('>I', zlib.crc32(tag + data) & 0xffffffff)
+	raw = b''.join(b'\x00' + row for row in rows) #(filter type 0 on every row)
+	with open(filename, 'wb') as f:
+		f.write(b'\x89PNG\r\n\x1a\n')
+		f.write(chunk(b'IHDR', struct.pack('>IIBBBBB', Width, Height, 8, 2, 0, 0, 0))) #8-bit RGB
+		f.write(chunk(b'IDAT', zlib.compress(raw, 9)))
+		f.write(chunk(b'IEND', b''))
+
+out_dir = sys.argv[1] if len(sys.argv) > 1 else '../dist/textures'
+if not os.path.isdir(out_dir): os.makedirs(out_dir)
+for number in range(1, 16):
+	filename = os.path.join(out_dir, 'ball-' + str(number) + '.png')
+	write_png(filename, face(number))
+	print("Wrote '" + filename + "'.")
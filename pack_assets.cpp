@@ -0,0 +1,729 @@
+//pack_assets: build meshes.blob / scene.blob from an intermediate dump.
+//
+// usage:
+//   pack_assets [-j threads] [-l levels] [-c cache_dir] [-o meshes.blob] [-s scene.txt scene.blob] file.obj [file.obj ...]
+//
+// Each 'o' section of each .obj becomes one mesh, named after the section.
+// Colors may be given per position as 'v x y z r g b' (0-1 floats); faces
+// may be any convex polygon (they are fanned into triangles). Texture
+// coordinates ('vt' lines, referenced as 'f v/vt/vn') go in a 't2f0' chunk.
+// Meshes that come out identical (e.g., every pool ball's sphere) are stored
+// once, with each of their idx0 entries pointing at the same vertices.
+//
+// Scene text files have one entry per line:
+//   name  px py pz  qx qy qz qw  sx sy sz  type radius [dynamic]
+// where 'type' is one of prop, ball, dozer, pocket (see SceneTag in main.cpp).
+//
+// models/export-pool-obj.py writes both files from pool.blend.
+//
+// With '-c cache_dir' (created if needed), each packed mesh is also stored in cache_dir under a
+// hash of its source text (and packing options); unchanged meshes are read
+// back from there instead of being re-processed. Sections that only use
+// relative (negative) face indices -- as export-pool-obj.py writes -- are
+// cached independently of where they sit in the obj file.
+//
+// Each mesh gets up to '-l levels' levels of detail (default 4, counting the
+// full mesh), made by quadric-error-metric simplification to 1/2, 1/4, ...
+// of the triangles. Coarser levels follow the full mesh in the v3n3/c4ub
+// chunks and are listed in a 'lod0' chunk parallel to 'idx0'.
+
+#include "mesh_id.hpp"
+#include "parallel_for.hpp"
+#include "simplify_mesh.hpp"
+
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <cctype>
+#include <cassert>
+#include <algorithm>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+struct v3n3 {
+	glm::vec3 v;
+	glm::vec3 n;
+};
+static_assert(sizeof(v3n3) == 24, "v3n3 is packed");
+
+struct c4ub {
+	uint8_t r, g, b, a;
+};
+static_assert(sizeof(c4ub) == 4, "c4ub is packed");
+
+struct t2f {
+	glm::vec2 t;
+};
+static_assert(sizeof(t2f) == 8, "t2f is packed");
+
+//one 'o' section of an obj file:
+struct ObjSection {
+	std::string name;
+	char const *begin = nullptr;
+	char const *end = nullptr;
+	uint32_t v_base = 0; //number of 'v' lines in file before this section
+	uint32_t vn_base = 0; //number of 'vn' lines in file before this section
+	uint32_t vt_base = 0; //number of 'vt' lines in file before this section
+};
+
+//a processed mesh, ready to be written:
+struct PackedMesh {
+	std::string name;
+	std::vector< v3n3 > data;
+	std::vector< c4ub > colors;
+	std::vector< t2f > texcoords; //(all zero if !has_texcoords)
+	bool has_texcoords = false; //some face corner had a texture coordinate
+	bool relative = true; //true if no face in the source used an absolute index
+	uint32_t full_count = 0; //vertices in the full-detail mesh (which starts at data[0])
+	std::vector< std::pair< uint32_t, uint32_t > > lods; //(start, count) of coarser levels within data
+};
+
+//options that change pack_section's output (and so are part of cache keys):
+struct PackOptions {
+	uint32_t lods = 4; //total levels of detail, including the full mesh
+};
+enum { MaxCoarseLODs = 3 }; //(lods - 1) is stored in fixed-size 'lod0' entries
+
+//bump this whenever pack_section's output changes, to invalidate old cache entries:
+static std::string const PackVersion = "pack_section v3";
+
+//64-bit FNV-1a, continuing from 'hash':
+static uint64_t hash_bytes(void const *data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL) {
+	uint8_t const *bytes = reinterpret_cast< uint8_t const * >(data);
+	for (size_t i = 0; i < size; ++i) {
+		hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static std::vector< char > read_file(std::string const &filename) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) throw std::runtime_error("Failed to open '" + filename + "'");
+	file.seekg(0, std::ios::end);
+	std::vector< char > bytes(size_t(file.tellg()));
+	file.seekg(0, std::ios::beg);
+	if (!bytes.empty() && !file.read(&bytes[0], bytes.size())) {
+		throw std::runtime_error("Failed to read '" + filename + "'");
+	}
+	return bytes;
+}
+
+static char const *line_end(char const *at, char const *end) {
+	char const *nl = reinterpret_cast< char const * >(std::memchr(at, '\n', end - at));
+	return nl ? nl : end;
+}
+
+//split obj text into sections (serial, but only looks at the first few bytes of each line):
+static std::vector< ObjSection > split_obj(std::string const &filename, std::vector< char > const &text) {
+	std::vector< ObjSection > sections;
+	if (text.empty()) return sections;
+
+	char const *begin = &text[0];
+	char const *end = begin + text.size();
+
+	ObjSection current;
+	current.name = filename; //anything before the first 'o' line
+	current.begin = begin;
+	uint32_t v_count = 0, vn_count = 0, vt_count = 0;
+	bool has_faces = false;
+
+	for (char const *at = begin; at < end; ) {
+		char const *next = line_end(at, end);
+		if (next - at >= 2 && at[0] == 'o' && at[1] == ' ') {
+			current.end = at;
+			if (has_faces) sections.emplace_back(current);
+			current = ObjSection();
+			current.name = std::string(at + 2, next);
+			while (!current.name.empty() && std::isspace(uint8_t(current.name.back()))) current.name.pop_back();
+			current.begin = next;
+			current.v_base = v_count;
+			current.vn_base = vn_count;
+			current.vt_base = vt_count;
+			has_faces = false;
+		} else if (next - at >= 2 && at[0] == 'v' && at[1] == ' ') {
+			v_count += 1;
+		} else if (next - at >= 3 && at[0] == 'v' && at[1] == 'n' && at[2] == ' ') {
+			vn_count += 1;
+		} else if (next - at >= 3 && at[0] == 'v' && at[1] == 't' && at[2] == ' ') {
+			vt_count += 1;
+		} else if (next - at >= 2 && at[0] == 'f' && at[1] == ' ') {
+			has_faces = true;
+		}
+		at = next + 1;
+	}
+	current.end = end;
+	if (has_faces) sections.emplace_back(current);
+	return sections;
+}
+
+//append simplified versions of mesh.data[0 .. full_count) to 'mesh':
+static void add_lods(PackOptions const &options, PackedMesh *mesh_) {
+	assert(mesh_);
+	auto &mesh = *mesh_;
+	uint32_t tris = mesh.full_count / 3;
+	if (options.lods <= 1 || tris < 64) return; //(small meshes aren't worth it)
+
+	std::vector< glm::vec3 > corners(mesh.full_count);
+	for (uint32_t i = 0; i < mesh.full_count; ++i) {
+		corners[i] = mesh.data[i].v;
+	}
+	std::vector< uint32_t > targets;
+	for (uint32_t l = 1; l < options.lods; ++l) {
+		targets.emplace_back(tris >> l);
+	}
+
+	std::vector< SimplifiedLevel > levels = simplify_mesh(corners, targets);
+	uint32_t previous = tris;
+	for (auto const &level : levels) {
+		uint32_t count = level.corners.size();
+		if (count / 3 > previous * 9 / 10) break; //(stalled; coarser levels would be the same)
+		mesh.lods.emplace_back(uint32_t(mesh.data.size()), count);
+		for (uint32_t i = 0; i < count; ++i) {
+			v3n3 vertex;
+			vertex.v = level.positions[i];
+			vertex.n = mesh.data[level.corners[i]].n;
+			mesh.data.emplace_back(vertex);
+			mesh.colors.emplace_back(mesh.colors[level.corners[i]]);
+			mesh.texcoords.emplace_back(mesh.texcoords[level.corners[i]]);
+		}
+		previous = count / 3;
+	}
+}
+
+//turn one obj section into a triangle list:
+static void pack_section(ObjSection const &section, PackOptions const &options, PackedMesh *mesh_) {
+	assert(mesh_);
+	auto &mesh = *mesh_;
+	mesh.name = section.name;
+
+	std::vector< glm::vec3 > positions;
+	std::vector< c4ub > position_colors;
+	std::vector< glm::vec3 > normals;
+	std::vector< glm::vec2 > uvs;
+
+	auto fail = [&](std::string const &what) {
+		throw std::runtime_error("In obj section '" + section.name + "': " + what);
+	};
+
+	//resolve a (1-based, global or negative-relative) obj index to an index into a local list:
+	auto resolve = [&](long index, uint32_t base, size_t count) -> uint32_t {
+		if (index > 0) mesh.relative = false;
+		long local = (index < 0 ? long(count) + index : index - 1 - long(base));
+		if (local < 0 || local >= long(count)) fail("face refers to a vertex outside its section");
+		return uint32_t(local);
+	};
+
+	struct Corner {
+		uint32_t v;
+		uint32_t vt; //-1U if none
+		uint32_t vn; //-1U if none
+	};
+	std::vector< Corner > polygon;
+	std::string line; //(copy of the current line; keeps strtof from running past it)
+
+	for (char const *at = section.begin; at < section.end; ) {
+		char const *next = line_end(at, section.end);
+		line.assign(at, next);
+		char const *c = line.c_str();
+		char *e = nullptr;
+		if (line.compare(0, 2, "v ") == 0) {
+			glm::vec3 p;
+			p.x = std::strtof(c + 2, &e);
+			p.y = std::strtof(e, &e);
+			p.z = std::strtof(e, &e);
+			positions.emplace_back(p);
+			//trailing values are a color only if there are exactly three ("v x y z r g b");
+			// a lone fourth is the standard (and here ignored) weight, "v x y z w":
+			float extra[4];
+			uint32_t extras = 0;
+			while (extras < 4) {
+				char *after = nullptr;
+				extra[extras] = std::strtof(e, &after);
+				if (after == e) break;
+				e = after;
+				extras += 1;
+			}
+			c4ub color;
+			color.r = color.g = color.b = color.a = 0xff;
+			if (extras == 3) {
+				auto to_byte = [](float x) { return uint8_t(std::max(0.0f, std::min(1.0f, x)) * 255.0f + 0.5f); };
+				color.r = to_byte(extra[0]);
+				color.g = to_byte(extra[1]);
+				color.b = to_byte(extra[2]);
+			}
+			position_colors.emplace_back(color);
+		} else if (line.compare(0, 3, "vn ") == 0) {
+			glm::vec3 n;
+			n.x = std::strtof(c + 3, &e);
+			n.y = std::strtof(e, &e);
+			n.z = std::strtof(e, &e);
+			normals.emplace_back(n);
+		} else if (line.compare(0, 3, "vt ") == 0) {
+			glm::vec2 t;
+			t.x = std::strtof(c + 3, &e);
+			t.y = std::strtof(e, &e);
+			uvs.emplace_back(t);
+		} else if (line.compare(0, 2, "f ") == 0) {
+			polygon.clear();
+			char const *p = c + 2;
+			while (true) {
+				while (*p == ' ' || *p == '\t' || *p == '\r') ++p;
+				if (*p == '\0') break;
+				Corner corner;
+				corner.v = resolve(std::strtol(p, &e, 10), section.v_base, positions.size());
+				corner.vt = -1U;
+				corner.vn = -1U;
+				p = e;
+				if (*p == '/') {
+					++p;
+					if (*p != '/') {
+						corner.vt = resolve(std::strtol(p, &e, 10), section.vt_base, uvs.size());
+						p = e;
+					}
+					if (*p == '/') {
+						++p;
+						corner.vn = resolve(std::strtol(p, &e, 10), section.vn_base, normals.size());
+						p = e;
+					}
+				}
+				while (*p && *p != ' ' && *p != '\t' && *p != '\r') ++p;
+				polygon.emplace_back(corner);
+			}
+			if (polygon.size() < 3) fail("face with fewer than three corners");
+			for (uint32_t i = 1; i + 1 < polygon.size(); ++i) {
+				Corner const tri[3] = { polygon[0], polygon[i], polygon[i+1] };
+				glm::vec3 cross = glm::cross(
+					positions[tri[1].v] - positions[tri[0].v],
+					positions[tri[2].v] - positions[tri[0].v]);
+				//(degenerate -- zero-area -- faces have no direction; any fixed normal will do, rather than NaNs)
+				float length = glm::length(cross);
+				glm::vec3 flat = (length > 0.0f && std::isfinite(length) ? cross / length : glm::vec3(0.0f, 0.0f, 1.0f));
+				for (auto const &corner : tri) {
+					v3n3 vertex;
+					vertex.v = positions[corner.v];
+					vertex.n = (corner.vn == -1U ? flat : normals[corner.vn]);
+					mesh.data.emplace_back(vertex);
+					mesh.colors.emplace_back(position_colors[corner.v]);
+					t2f texcoord;
+					texcoord.t = (corner.vt == -1U ? glm::vec2(0.0f) : uvs[corner.vt]);
+					mesh.texcoords.emplace_back(texcoord);
+					if (corner.vt != -1U) mesh.has_texcoords = true;
+				}
+			}
+		}
+		at = next + 1;
+	}
+
+	mesh.full_count = mesh.data.size();
+	add_lods(options, &mesh);
+}
+
+//cache files hold a vertex count, v3n3, c4ub, and t2f data, whether there were texcoords, the full-detail count, and a list of lods:
+static std::string cache_path(std::string const &cache_dir, uint64_t key) {
+	char hex[17];
+	std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)key);
+	return cache_dir + "/" + hex + ".mesh";
+}
+
+static bool read_cached(std::string const &path, PackedMesh *mesh_) {
+	assert(mesh_);
+	auto &mesh = *mesh_;
+	std::ifstream file(path, std::ios::binary);
+	uint32_t count = 0;
+	if (!file.read(reinterpret_cast< char * >(&count), sizeof(count))) return false;
+	mesh.data.resize(count);
+	mesh.colors.resize(count);
+	mesh.texcoords.resize(count);
+	if (count != 0) {
+		if (!file.read(reinterpret_cast< char * >(&mesh.data[0]), count * sizeof(v3n3))) return false;
+		if (!file.read(reinterpret_cast< char * >(&mesh.colors[0]), count * sizeof(c4ub))) return false;
+		if (!file.read(reinterpret_cast< char * >(&mesh.texcoords[0]), count * sizeof(t2f))) return false;
+	}
+	uint32_t has_texcoords = 0;
+	if (!file.read(reinterpret_cast< char * >(&has_texcoords), sizeof(has_texcoords))) return false;
+	mesh.has_texcoords = (has_texcoords != 0);
+	uint32_t lods = 0;
+	if (!file.read(reinterpret_cast< char * >(&mesh.full_count), sizeof(mesh.full_count))) return false;
+	if (!file.read(reinterpret_cast< char * >(&lods), sizeof(lods))) return false;
+	if (lods > MaxCoarseLODs) return false;
+	mesh.lods.resize(lods);
+	for (auto &lod : mesh.lods) {
+		if (!file.read(reinterpret_cast< char * >(&lod.first), sizeof(lod.first))) return false;
+		if (!file.read(reinterpret_cast< char * >(&lod.second), sizeof(lod.second))) return false;
+	}
+	//(a stale or damaged entry mustn't point write_meshes past the vertices it has)
+	if (mesh.full_count > count) return false;
+	for (auto const &lod : mesh.lods) {
+		if (lod.first > count || lod.second > count - lod.first) return false;
+	}
+	return true;
+}
+
+//make 'cache_dir' if it isn't there already:
+// note: throws if it can't be made.
+static void make_cache_dir(std::string const &cache_dir) {
+	#ifdef _WIN32
+	int result = _mkdir(cache_dir.c_str());
+	#else
+	int result = mkdir(cache_dir.c_str(), 0755);
+	#endif
+	if (result != 0 && errno != EEXIST) {
+		throw std::runtime_error("Failed to create cache directory '" + cache_dir + "': " + std::strerror(errno));
+	}
+	//(EEXIST could also be a file of that name, which shows up here)
+	struct stat info;
+	if (stat(cache_dir.c_str(), &info) != 0 || !(info.st_mode & S_IFDIR)) {
+		throw std::runtime_error("Cache path '" + cache_dir + "' isn't a directory.");
+	}
+}
+
+static void write_cached(std::string const &path, PackedMesh const &mesh) {
+	//write under a temporary name and rename, so a crash can't leave a partial entry:
+	std::ostringstream tmp;
+	tmp << path << ".tmp-" << std::this_thread::get_id();
+	{
+		std::ofstream file(tmp.str(), std::ios::binary);
+		uint32_t count = mesh.data.size();
+		file.write(reinterpret_cast< char const * >(&count), sizeof(count));
+		if (count) {
+			file.write(reinterpret_cast< char const * >(&mesh.data[0]), count * sizeof(v3n3));
+			file.write(reinterpret_cast< char const * >(&mesh.colors[0]), count * sizeof(c4ub));
+			file.write(reinterpret_cast< char const * >(&mesh.texcoords[0]), count * sizeof(t2f));
+		}
+		uint32_t has_texcoords = (mesh.has_texcoords ? 1 : 0);
+		file.write(reinterpret_cast< char const * >(&has_texcoords), sizeof(has_texcoords));
+		uint32_t lods = mesh.lods.size();
+		file.write(reinterpret_cast< char const * >(&mesh.full_count), sizeof(mesh.full_count));
+		file.write(reinterpret_cast< char const * >(&lods), sizeof(lods));
+		for (auto const &lod : mesh.lods) {
+			file.write(reinterpret_cast< char const * >(&lod.first), sizeof(lod.first));
+			file.write(reinterpret_cast< char const * >(&lod.second), sizeof(lod.second));
+		}
+		if (!file) {
+			std::cerr << "WARNING: failed to write cache entry '" << tmp.str() << "'." << std::endl;
+			return;
+		}
+	}
+	std::remove(path.c_str());
+	if (std::rename(tmp.str().c_str(), path.c_str()) != 0) {
+		std::cerr << "WARNING: failed to rename cache entry to '" << path << "'." << std::endl;
+		std::remove(tmp.str().c_str());
+	}
+}
+
+//pack a section, reusing a cached result if its source hasn't changed:
+// returns true if the section actually had to be processed.
+static bool pack_section_cached(std::string const &cache_dir, ObjSection const &section, PackOptions const &options, PackedMesh *mesh_) {
+	assert(mesh_);
+	auto &mesh = *mesh_;
+	if (cache_dir.empty()) {
+		pack_section(section, options, &mesh);
+		return true;
+	}
+
+	//key for sections that only use relative indices (position in file doesn't matter):
+	uint64_t key = hash_bytes(PackVersion.data(), PackVersion.size());
+	key = hash_bytes(&options.lods, sizeof(options.lods), key);
+	key = hash_bytes(section.name.data(), section.name.size(), key);
+	key = hash_bytes(section.begin, section.end - section.begin, key);
+	//key for sections that use absolute indices:
+	uint64_t based_key = hash_bytes(&section.v_base, sizeof(section.v_base), key);
+	based_key = hash_bytes(&section.vn_base, sizeof(section.vn_base), based_key);
+	based_key = hash_bytes(&section.vt_base, sizeof(section.vt_base), based_key);
+
+	mesh.name = section.name;
+	if (read_cached(cache_path(cache_dir, key), &mesh)) return false;
+	if (read_cached(cache_path(cache_dir, based_key), &mesh)) return false;
+
+	mesh = PackedMesh();
+	pack_section(section, options, &mesh);
+	write_cached(cache_path(cache_dir, mesh.relative ? key : based_key), mesh);
+	return true;
+}
+
+template< typename T >
+static void write_chunk(std::ostream &to, char const (&magic)[5], std::vector< T > const &data) {
+	if (uint64_t(data.size()) * sizeof(T) > UINT32_MAX) {
+		throw std::runtime_error(std::string("'") + magic + "' chunk would be over 4GB (chunk sizes are 32 bits)");
+	}
+	uint32_t size = uint32_t(data.size() * sizeof(T));
+	to.write(magic, 4);
+	to.write(reinterpret_cast< char const * >(&size), sizeof(size));
+	if (size) to.write(reinterpret_cast< char const * >(&data[0]), size);
+}
+
+static void write_meshes(std::string const &filename, std::vector< PackedMesh > const &meshes) {
+	struct IndexEntry {
+		uint32_t name_begin, name_end;
+		uint32_t vertex_start, vertex_count;
+	};
+	static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
+	struct LodEntry {
+		uint32_t count; //number of coarser levels
+		struct { uint32_t vertex_start, vertex_count; } levels[MaxCoarseLODs];
+	};
+	static_assert(sizeof(LodEntry) == 4 + 8 * MaxCoarseLODs, "Lod entry should be packed");
+
+	//meshes identical to an earlier one (same vertices, colors, texcoords, and levels) aren't stored again:
+	auto mesh_hash = [](PackedMesh const &mesh) {
+		uint64_t hash = hash_bytes(&mesh.full_count, sizeof(mesh.full_count));
+		if (!mesh.data.empty()) {
+			hash = hash_bytes(&mesh.data[0], mesh.data.size() * sizeof(v3n3), hash);
+			hash = hash_bytes(&mesh.colors[0], mesh.colors.size() * sizeof(c4ub), hash);
+			hash = hash_bytes(&mesh.texcoords[0], mesh.texcoords.size() * sizeof(t2f), hash);
+		}
+		return hash;
+	};
+	auto same_mesh = [](PackedMesh const &a, PackedMesh const &b) {
+		return a.full_count == b.full_count && a.lods == b.lods && a.data.size() == b.data.size()
+			&& (a.data.empty() || (
+				std::memcmp(&a.data[0], &b.data[0], a.data.size() * sizeof(v3n3)) == 0
+				&& std::memcmp(&a.colors[0], &b.colors[0], a.colors.size() * sizeof(c4ub)) == 0
+				&& std::memcmp(&a.texcoords[0], &b.texcoords[0], a.texcoords.size() * sizeof(t2f)) == 0));
+	};
+	std::unordered_map< uint64_t, std::vector< uint32_t > > by_hash; //mesh hash -> stored meshes with that hash
+	std::vector< uint32_t > stored_at(meshes.size(), -1U); //first vertex of each mesh's (possibly shared) data
+	std::vector< bool > stored(meshes.size(), false); //does the mesh's own data get written?
+
+	size_t total = 0;
+	bool has_texcoords = false;
+	uint32_t shared = 0;
+	for (uint32_t i = 0; i < meshes.size(); ++i) {
+		auto &candidates = by_hash[mesh_hash(meshes[i])];
+		for (uint32_t c : candidates) {
+			if (same_mesh(meshes[c], meshes[i])) {
+				stored_at[i] = stored_at[c];
+				break;
+			}
+		}
+		if (stored_at[i] != -1U) {
+			shared += 1;
+			continue;
+		}
+		candidates.emplace_back(i);
+		//(vertex starts are stored as 32 bits; -1U marks "not stored yet")
+		if (uint64_t(total) + meshes[i].data.size() >= uint64_t(-1U)) {
+			throw std::runtime_error("Too many vertices to index with 32 bits (at mesh '" + meshes[i].name + "')");
+		}
+		stored_at[i] = uint32_t(total);
+		stored[i] = true;
+		total += meshes[i].data.size();
+		has_texcoords = has_texcoords || meshes[i].has_texcoords;
+	}
+
+	std::vector< char > strings;
+	std::vector< IndexEntry > index;
+	std::vector< MeshID > ids;
+	std::vector< LodEntry > lods;
+	for (uint32_t i = 0; i < meshes.size(); ++i) {
+		PackedMesh const &mesh = meshes[i];
+		uint32_t start = stored_at[i];
+		IndexEntry entry;
+		entry.name_begin = strings.size();
+		strings.insert(strings.end(), mesh.name.begin(), mesh.name.end());
+		entry.name_end = strings.size();
+		entry.vertex_start = start;
+		entry.vertex_count = mesh.full_count;
+		index.emplace_back(entry);
+		ids.emplace_back(mesh_id(mesh.name.data(), mesh.name.data() + mesh.name.size()));
+
+		LodEntry lod;
+		std::memset(&lod, 0, sizeof(lod));
+		lod.count = std::min< uint32_t >(mesh.lods.size(), MaxCoarseLODs);
+		for (uint32_t l = 0; l < lod.count; ++l) {
+			lod.levels[l].vertex_start = start + mesh.lods[l].first;
+			lod.levels[l].vertex_count = mesh.lods[l].second;
+		}
+		lods.emplace_back(lod);
+	}
+
+	std::vector< char > buffer(1 << 20);
+	std::ofstream file;
+	file.rdbuf()->pubsetbuf(&buffer[0], buffer.size());
+	file.open(filename, std::ios::binary);
+	if (!file) throw std::runtime_error("Failed to open '" + filename + "' for writing");
+
+	//v3n3, c4ub, and t2f0 chunks are streamed mesh-by-mesh rather than concatenated first:
+	auto stream_chunk = [&](char const (&magic)[5], size_t element_size, std::function< void const *(PackedMesh const &) > const &elements) {
+		if (uint64_t(total) * element_size > UINT32_MAX) {
+			throw std::runtime_error(std::string("'") + magic + "' chunk would be over 4GB (chunk sizes are 32 bits); split the meshes over several files");
+		}
+		uint32_t size = uint32_t(total * element_size);
+		file.write(magic, 4);
+		file.write(reinterpret_cast< char const * >(&size), sizeof(size));
+		for (uint32_t i = 0; i < meshes.size(); ++i) {
+			if (!stored[i] || meshes[i].data.empty()) continue;
+			file.write(reinterpret_cast< char const * >(elements(meshes[i])), meshes[i].data.size() * element_size);
+		}
+	};
+	stream_chunk("v3n3", sizeof(v3n3), [](PackedMesh const &mesh) -> void const * { return &mesh.data[0]; });
+	write_chunk(file, "str0", strings);
+	write_chunk(file, "idx0", index);
+	write_chunk(file, "id64", ids);
+	stream_chunk("c4ub", sizeof(c4ub), [](PackedMesh const &mesh) -> void const * { return &mesh.colors[0]; });
+	write_chunk(file, "lod0", lods);
+	if (has_texcoords) { //(optional, so files without texture coordinates don't carry a chunk of zeros)
+		stream_chunk("t2f0", sizeof(t2f), [](PackedMesh const &mesh) -> void const * { return &mesh.texcoords[0]; });
+	}
+
+	if (!file) throw std::runtime_error("Failed to write '" + filename + "'");
+	std::cout << "Wrote " << file.tellp() << " bytes (" << meshes.size() << " meshes";
+	if (shared) std::cout << ", " << shared << " of them sharing another's vertices";
+	std::cout << ", " << total << " vertices) to " << filename << std::endl;
+}
+
+static void write_scene(std::string const &text_filename, std::string const &filename) {
+	struct SceneEntry {
+		uint32_t name_begin, name_end;
+		glm::vec3 position;
+		float rotation[4]; //x,y,z,w (as glm::quat)
+		glm::vec3 scale;
+	};
+	static_assert(sizeof(SceneEntry) == 48, "Scene entry should be packed");
+	struct SceneTag {
+		uint32_t type;
+		float radius;
+		uint32_t flags;
+	};
+	static_assert(sizeof(SceneTag) == 12, "Scene tag should be packed");
+
+	std::ifstream text(text_filename);
+	if (!text) throw std::runtime_error("Failed to open '" + text_filename + "'");
+
+	std::vector< char > strings;
+	std::vector< SceneEntry > scene;
+	std::vector< SceneTag > tags;
+	//each distinct name is stored once:
+	std::unordered_map< std::string, std::pair< uint32_t, uint32_t > > names;
+
+	std::string line;
+	uint32_t line_number = 0;
+	while (std::getline(text, line)) {
+		line_number += 1;
+		if (line.empty() || line[0] == '#') continue;
+		std::istringstream str(line);
+		std::string name, type;
+		SceneEntry entry;
+		SceneTag tag;
+		if (!(str >> name
+			>> entry.position.x >> entry.position.y >> entry.position.z
+			>> entry.rotation[0] >> entry.rotation[1] >> entry.rotation[2] >> entry.rotation[3]
+			>> entry.scale.x >> entry.scale.y >> entry.scale.z
+			>> type >> tag.radius)) {
+			throw std::runtime_error(text_filename + ":" + std::to_string(line_number) + ": malformed scene entry");
+		}
+		if (type == "prop") tag.type = 0;
+		else if (type == "ball") tag.type = 1;
+		else if (type == "dozer") tag.type = 2;
+		else if (type == "pocket") tag.type = 3;
+		else throw std::runtime_error(text_filename + ":" + std::to_string(line_number) + ": unknown type '" + type + "'");
+		tag.flags = 0;
+		std::string flag;
+		while (str >> flag) {
+			if (flag == "dynamic") tag.flags |= 0x1;
+			else throw std::runtime_error(text_filename + ":" + std::to_string(line_number) + ": unknown flag '" + flag + "'");
+		}
+
+		auto f = names.find(name);
+		if (f == names.end()) {
+			uint32_t begin = strings.size();
+			strings.insert(strings.end(), name.begin(), name.end());
+			f = names.insert(std::make_pair(name, std::make_pair(begin, uint32_t(strings.size())))).first;
+		}
+		entry.name_begin = f->second.first;
+		entry.name_end = f->second.second;
+		scene.emplace_back(entry);
+		tags.emplace_back(tag);
+	}
+
+	std::ofstream file(filename, std::ios::binary);
+	if (!file) throw std::runtime_error("Failed to open '" + filename + "' for writing");
+	write_chunk(file, "str0", strings);
+	write_chunk(file, "scn0", scene);
+	write_chunk(file, "tag0", tags);
+	if (!file) throw std::runtime_error("Failed to write '" + filename + "'");
+	std::cout << "Wrote " << file.tellp() << " bytes (" << scene.size() << " entries) to " << filename << std::endl;
+}
+
+int main(int argc, char **argv) {
+	uint32_t threads = 0;
+	std::string meshes_out = "meshes.blob";
+	std::string scene_in, scene_out;
+	std::string cache_dir;
+	PackOptions options;
+	std::vector< std::string > objs;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "-j" && i + 1 < argc) {
+			threads = std::atoi(argv[++i]);
+		} else if (arg == "-o" && i + 1 < argc) {
+			meshes_out = argv[++i];
+		} else if (arg == "-l" && i + 1 < argc) {
+			options.lods = std::max(1, std::min(int(MaxCoarseLODs) + 1, std::atoi(argv[++i])));
+		} else if (arg == "-c" && i + 1 < argc) {
+			cache_dir = argv[++i];
+		} else if (arg == "-s" && i + 2 < argc) {
+			scene_in = argv[++i];
+			scene_out = argv[++i];
+		} else if (!arg.empty() && arg[0] == '-') {
+			std::cerr << "Usage:\n\t" << argv[0] << " [-j threads] [-l levels] [-c cache_dir] [-o meshes.blob] [-s scene.txt scene.blob] file.obj [file.obj ...]" << std::endl;
+			return 1;
+		} else {
+			objs.emplace_back(arg);
+		}
+	}
+
+	try {
+		auto before = std::chrono::high_resolution_clock::now();
+
+		//obj files stay in memory while their sections are processed:
+		std::vector< std::vector< char > > texts;
+		std::vector< ObjSection > sections;
+		for (auto const &obj : objs) {
+			texts.emplace_back(read_file(obj));
+			std::vector< ObjSection > found = split_obj(obj, texts.back());
+			sections.insert(sections.end(), found.begin(), found.end());
+		}
+
+		if (!cache_dir.empty()) make_cache_dir(cache_dir);
+
+		std::vector< PackedMesh > meshes(sections.size());
+		std::atomic< uint32_t > processed(0);
+		parallel_for(sections.size(), [&](uint32_t i) {
+			if (pack_section_cached(cache_dir, sections[i], options, &meshes[i])) processed += 1;
+		}, threads);
+		if (!cache_dir.empty()) {
+			std::cout << "Processed " << processed << " of " << sections.size() << " meshes (the rest were cached in '" << cache_dir << "')." << std::endl;
+		}
+
+		if (!objs.empty()) write_meshes(meshes_out, meshes);
+		if (!scene_in.empty()) write_scene(scene_in, scene_out);
+
+		auto after = std::chrono::high_resolution_clock::now();
+		std::cout << "Packed in " << std::chrono::duration< double >(after - before).count() << " seconds." << std::endl;
+	} catch (std::exception &e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <exception>
+#include <algorithm>
+#include <stdint.h>
+
+//run body(i) for every i in [0,count), spread over up to 'threads' threads (0 => one per core):
+// note: items are handed out one at a time, so uneven item sizes balance out.
+// note: if any body throws, remaining items are skipped and the first exception is rethrown here.
+template< typename F >
+void parallel_for(uint32_t count, F const &body, uint32_t threads = 0) {
+	if (threads == 0) threads = std::max(1U, std::thread::hardware_concurrency());
+	threads = std::min(threads, count);
+	if (threads <= 1) {
+		for (uint32_t i = 0; i < count; ++i) body(i);
+		return;
+	}
+
+	std::atomic< uint32_t > next(0);
+	std::exception_ptr error;
+	std::mutex error_mutex;
+	auto work = [&]() {
+		while (true) {
+			uint32_t i = next.fetch_add(1);
+			if (i >= count) break;
+			try {
+				body(i);
+			} catch (...) {
+				std::lock_guard< std::mutex > lock(error_mutex);
+				if (!error) error = std::current_exception();
+				next.store(count);
+			}
+		}
+	};
+
+	std::vector< std::thread > pool;
+	for (uint32_t t = 1; t < threads; ++t) {
+		pool.emplace_back(work);
+	}
+	work();
+	for (auto &thread : pool) {
+		thread.join();
+	}
+	if (error) std::rethrow_exception(error);
+}
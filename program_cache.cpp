@@ -0,0 +1,222 @@
+#include "program_cache.hpp"
+#include "read_chunk.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <stdexcept>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+GLuint compile_shader(GLenum type, std::string const &source) {
+	GLuint shader = glCreateShader(type);
+	GLchar const *str = source.c_str();
+	GLint length = source.size();
+	glShaderSource(shader, 1, &str, &length);
+	glCompileShader(shader);
+	GLint compile_status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
+	if (compile_status != GL_TRUE) {
+		std::cerr << "Failed to compile shader." << std::endl;
+		GLint info_log_length = 0;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_log_length);
+		std::vector< GLchar > info_log(info_log_length, 0);
+		GLsizei length = 0;
+		glGetShaderInfoLog(shader, info_log.size(), &length, &info_log[0]);
+		std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
+		glDeleteShader(shader);
+		throw std::runtime_error("Failed to compile shader.");
+	}
+	return shader;
+}
+
+//glProgramParameteri, glGetProgramBinary, and glProgramBinary are GL 4.1 (or GL_ARB_get_program_binary),
+// so they're looked up at runtime (by init_program_binaries) rather than assumed:
+static struct {
+	bool supported = false;
+	PFNGLPROGRAMPARAMETERIPROC ProgramParameteri = nullptr;
+	PFNGLGETPROGRAMBINARYPROC GetProgramBinary = nullptr;
+	PFNGLPROGRAMBINARYPROC ProgramBinary = nullptr;
+} binaries;
+
+bool init_program_binaries(void *(*get_proc_address)(char const *)) {
+	binaries.supported = false;
+
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	bool core = (major > 4 || (major == 4 && minor >= 1));
+	bool extension = false;
+	//(glGetStringi isn't in gl_shims, so it's looked up too)
+	PFNGLGETSTRINGIPROC GetStringi = (PFNGLGETSTRINGIPROC)get_proc_address("glGetStringi");
+	if (!core && GetStringi) {
+		GLint extensions = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+		for (GLint i = 0; i < extensions; ++i) {
+			char const *name = reinterpret_cast< char const * >(GetStringi(GL_EXTENSIONS, i));
+			if (name && std::strcmp(name, "GL_ARB_get_program_binary") == 0) extension = true;
+		}
+	}
+	if (!core && !extension) return false;
+
+	binaries.ProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)get_proc_address("glProgramParameteri");
+	binaries.GetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)get_proc_address("glGetProgramBinary");
+	binaries.ProgramBinary = (PFNGLPROGRAMBINARYPROC)get_proc_address("glProgramBinary");
+	if (!binaries.ProgramParameteri || !binaries.GetProgramBinary || !binaries.ProgramBinary) {
+		return false;
+	}
+	//(drivers may support the extension but no formats -- then there's nothing to save)
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	binaries.supported = (formats > 0);
+	return binaries.supported;
+}
+
+GLuint link_program(GLuint fragment_shader, GLuint vertex_shader, bool retrievable) {
+	GLuint program = glCreateProgram();
+	if (retrievable && binaries.supported) {
+		binaries.ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glAttachShader(program, vertex_shader);
+	glAttachShader(program, fragment_shader);
+	glLinkProgram(program);
+	GLint link_status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+	if (link_status != GL_TRUE) {
+		std::cerr << "Failed to link shader program." << std::endl;
+		GLint info_log_length = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &info_log_length);
+		std::vector< GLchar > info_log(info_log_length, 0);
+		GLsizei length = 0;
+		glGetProgramInfoLog(program, info_log.size(), &length, &info_log[0]);
+		std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
+		throw std::runtime_error("Failed to link program");
+	}
+	return program;
+}
+
+//64-bit FNV-1a, continued from 'hash':
+static uint64_t hash_string(std::string const &str, uint64_t hash = 0xcbf29ce484222325ULL) {
+	for (char c : str) {
+		hash = (hash ^ uint8_t(c)) * 0x100000001b3ULL;
+	}
+	return (hash ^ 0xff) * 0x100000001b3ULL; //(terminator, so "ab"+"c" and "a"+"bc" differ)
+}
+
+static std::string gl_string(GLenum name) {
+	GLubyte const *str = glGetString(name);
+	return str ? std::string(reinterpret_cast< char const * >(str)) : std::string();
+}
+
+//cache entries are a 'fmt0' chunk (one uint32 binary format) followed by a 'bin0' chunk (the binary):
+static bool read_binary(std::string const &path, GLenum *format, std::vector< char > *binary) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) return false;
+	std::vector< ChunkInfo > toc = index_chunks(file);
+	ChunkInfo const *format_chunk = find_chunk(toc, "fmt0");
+	ChunkInfo const *binary_chunk = find_chunk(toc, "bin0");
+	if (!format_chunk || !binary_chunk || binary_chunk->size == 0) return false;
+	try {
+		std::vector< uint32_t > formats;
+		read_chunk(file, *format_chunk, &formats);
+		if (formats.size() != 1) return false;
+		*format = formats[0];
+		read_chunk(file, *binary_chunk, binary);
+	} catch (std::runtime_error &) {
+		return false;
+	}
+	return true;
+}
+
+static void write_binary(std::string const &cache_dir, std::string const &path, GLenum format, std::vector< char > const &binary) {
+	#ifdef _WIN32
+	_mkdir(cache_dir.c_str());
+	#else
+	mkdir(cache_dir.c_str(), 0755);
+	#endif
+	//(errors from mkdir -- usually "already exists" -- show up as failure to open below)
+
+	//write under a temporary name and rename, so a crash can't leave a partial entry:
+	std::string tmp = path + ".tmp";
+	{
+		std::ofstream file(tmp, std::ios::binary);
+		auto write_chunk = [&](char const *magic, void const *data, uint32_t size) {
+			file.write(magic, 4);
+			file.write(reinterpret_cast< char const * >(&size), sizeof(size));
+			file.write(reinterpret_cast< char const * >(data), size);
+		};
+		uint32_t format_u32 = format;
+		write_chunk("fmt0", &format_u32, sizeof(format_u32));
+		write_chunk("bin0", binary.data(), binary.size());
+		if (!file) {
+			std::cerr << "NOTE: couldn't write program binary to '" << tmp << "'." << std::endl;
+			file.close();
+			std::remove(tmp.c_str());
+			return;
+		}
+	}
+	std::remove(path.c_str()); //(rename won't replace an existing file on windows)
+	if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+		std::cerr << "NOTE: couldn't rename program binary to '" << path << "'." << std::endl;
+		std::remove(tmp.c_str());
+	}
+}
+
+GLuint cached_program(std::string const &vertex_source, std::string const &fragment_source, std::string const &cache_dir) {
+	auto compile = [&](bool retrievable) {
+		GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_source);
+		GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+		GLuint program = link_program(fragment_shader, vertex_shader, retrievable);
+		glDeleteShader(vertex_shader); //(freed once the program is deleted)
+		glDeleteShader(fragment_shader);
+		return program;
+	};
+
+	if (!binaries.supported) return compile(false);
+
+	uint64_t key = hash_string(vertex_source);
+	key = hash_string(fragment_source, key);
+	key = hash_string(gl_string(GL_VENDOR), key);
+	key = hash_string(gl_string(GL_RENDERER), key);
+	key = hash_string(gl_string(GL_VERSION), key);
+	char hex[17];
+	std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)key);
+	std::string path = cache_dir + "/" + hex + ".program";
+
+	{ //try the cached binary:
+		GLenum format = 0;
+		std::vector< char > binary;
+		if (read_binary(path, &format, &binary)) {
+			GLuint program = glCreateProgram();
+			binaries.ProgramBinary(program, format, binary.data(), binary.size());
+			GLint link_status = GL_FALSE;
+			glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+			if (link_status == GL_TRUE) return program;
+			//(drivers may reject binaries for reasons the key doesn't capture; just rebuild)
+			glDeleteProgram(program);
+		}
+	}
+
+	GLuint program = compile(true);
+
+	{ //save the binary for next time:
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length > 0) {
+			std::vector< char > binary(length);
+			GLenum format = 0;
+			GLsizei written = 0;
+			binaries.GetProgramBinary(program, length, &written, &format, binary.data());
+			binary.resize(written);
+			if (!binary.empty()) write_binary(cache_dir, path, format, binary);
+		}
+	}
+
+	return program;
+}
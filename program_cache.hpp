@@ -0,0 +1,26 @@
+#pragma once
+
+#include "GL.hpp"
+#include <string>
+
+//compile a shader from source:
+// note: prints the info log and throws on failure.
+GLuint compile_shader(GLenum type, std::string const &source);
+
+//link a program from compiled shaders:
+// note: prints the info log and throws on failure.
+// note: 'retrievable' asks the driver to keep a binary around for glGetProgramBinary.
+GLuint link_program(GLuint fragment_shader, GLuint vertex_shader, bool retrievable = false);
+
+//look up the program binary functions on the current context; call before cached_program
+// (without it, cached_program just compiles from source):
+// 'get_proc_address' looks up GL functions (e.g., SDL_GL_GetProcAddress, or HeadlessGL::get_proc_address)
+// returns false if program binaries aren't supported.
+bool init_program_binaries(void *(*get_proc_address)(char const *));
+
+//build a program from vertex and fragment source, reusing a binary saved in 'cache_dir'
+// (via glGetProgramBinary) by an earlier run if there is one.
+// Binaries are keyed by a hash of the sources plus the GL vendor, renderer, and version
+// strings, so driver or hardware changes just miss the cache. If program binaries aren't
+// supported (or a cached one is rejected), the program is compiled from source as usual.
+GLuint cached_program(std::string const &vertex_source, std::string const &fragment_source, std::string const &cache_dir = "shader-cache");
@@ -2,20 +2,22 @@
 
 #include <iostream>
 #include <vector>
+#include <string>
 #include <stdexcept>
 #include <cassert>
+#include <stdint.h>
+
+struct ChunkHeader {
+	char magic[4] = {'\0', '\0', '\0', '\0'};
+	uint32_t size = 0;
+};
+static_assert(sizeof(ChunkHeader) == 8, "header is packed");
 
 template< typename T >
 void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *_to) {
 	assert(_to);
 	auto &to = *_to;
 
-	struct ChunkHeader {
-		char magic[4] = {'\0', '\0', '\0', '\0'};
-		uint32_t size = 0;
-	};
-	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
-
 	ChunkHeader header;
 	if (!from.read(reinterpret_cast< char * >(&header), sizeof(header))) {
 		throw std::runtime_error("Failed to read chunk header");
@@ -33,3 +35,66 @@ void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *
 		throw std::runtime_error("Failed to read chunk data.");
 	}
 }
+
+//"table of contents" entry for a chunk; lets callers skip or defer reading chunk data:
+struct ChunkInfo {
+	std::string magic;
+	std::streamoff offset = 0; //offset of chunk data (just past the header) from start of stream
+	uint32_t size = 0; //size of chunk data in bytes
+};
+
+//read every chunk header in a stream, seeking past the data:
+// note: stops (and sets *trailing, if given) at data that doesn't parse as a chunk.
+inline std::vector< ChunkInfo > index_chunks(std::istream &from, bool *trailing = nullptr) {
+	if (trailing) *trailing = false;
+
+	from.seekg(0, std::ios::end);
+	std::streamoff end = from.tellg();
+	from.seekg(0, std::ios::beg);
+
+	std::vector< ChunkInfo > toc;
+	std::streamoff at = 0;
+	while (at < end) {
+		ChunkHeader header;
+		if (end - at < std::streamoff(sizeof(header))
+		 || !from.read(reinterpret_cast< char * >(&header), sizeof(header))
+		 || std::streamoff(header.size) > end - at - std::streamoff(sizeof(header))) {
+			if (trailing) *trailing = true;
+			break;
+		}
+		ChunkInfo info;
+		info.magic = std::string(header.magic, 4);
+		info.offset = at + sizeof(header);
+		info.size = header.size;
+		toc.emplace_back(info);
+		at = info.offset + info.size;
+		from.seekg(at, std::ios::beg);
+	}
+	from.clear();
+	return toc;
+}
+
+//look up a chunk by magic number in a table of contents (nullptr if missing):
+inline ChunkInfo const *find_chunk(std::vector< ChunkInfo > const &toc, std::string const &magic) {
+	for (auto const &info : toc) {
+		if (info.magic == magic) return &info;
+	}
+	return nullptr;
+}
+
+//read a chunk located with index_chunks:
+template< typename T >
+void read_chunk(std::istream &from, ChunkInfo const &info, std::vector< T > *_to) {
+	assert(_to);
+	auto &to = *_to;
+
+	if (info.size % sizeof(T) != 0) {
+		throw std::runtime_error("Size of chunk not divisible by element size");
+	}
+
+	to.resize(info.size / sizeof(T));
+	from.seekg(info.offset, std::ios::beg);
+	if (!from.read(reinterpret_cast< char * >(&to[0]), to.size() * sizeof(T))) {
+		throw std::runtime_error("Failed to read chunk data.");
+	}
+}
@@ -0,0 +1,54 @@
+#include "shader_variants.hpp"
+#include "program_cache.hpp"
+#include "Scene.hpp"
+
+#include <stdexcept>
+#include <cassert>
+
+ShaderVariants::ShaderVariants(std::string const &vertex_body_, std::string const &fragment_body_)
+	: vertex_body(vertex_body_), fragment_body(fragment_body_), variants(1 << FeatureCount) {
+}
+
+ShaderVariants::Variant const &ShaderVariants::get(uint32_t key) {
+	if (key >= variants.size()) {
+		throw std::runtime_error("Shader variant key has unknown feature bits.");
+	}
+	Variant &variant = variants[key];
+	if (variant.program != 0) return variant;
+
+	std::string header = "#version 330\n";
+	if (key & UniformScale) header += "#define UNIFORM_SCALE\n";
+	if (key & VertexColors) header += "#define VERTEX_COLORS\n";
+	if (key & Fog) header += "#define FOG\n";
+	if (key & Textured) header += "#define TEXTURED\n";
+	if (key & Instanced) header += "#define INSTANCED\n#define MAX_INSTANCES " + std::to_string(Scene::MaxInstances) + "\n";
+	static_assert(FeatureCount == 5, "every feature has a #define above");
+
+	variant.program = cached_program(header + vertex_body, header + fragment_body);
+
+	//look up uniform locations (which uniforms exist depends on the features):
+	if (key & Instanced) {
+		variant.projection = glGetUniformLocation(variant.program, "projection");
+		if (variant.projection == -1U) throw std::runtime_error("no uniform named projection");
+		GLuint instances = glGetUniformBlockIndex(variant.program, "Instances");
+		if (instances == GL_INVALID_INDEX) throw std::runtime_error("no uniform block named Instances");
+		glUniformBlockBinding(variant.program, instances, Scene::InstancesBinding);
+	} else {
+		variant.mvp = glGetUniformLocation(variant.program, "mvp");
+		if (variant.mvp == -1U) throw std::runtime_error("no uniform named mvp");
+		variant.mv = glGetUniformLocation(variant.program, "mv");
+		variant.itmv = glGetUniformLocation(variant.program, "itmv");
+		if (!(key & UniformScale) && variant.itmv == -1U) throw std::runtime_error("no uniform named itmv");
+		variant.layer = glGetUniformLocation(variant.program, "layer");
+	}
+	if (key & Textured) {
+		GLuint tex = glGetUniformLocation(variant.program, "tex");
+		if (tex == -1U) throw std::runtime_error("no uniform named tex");
+		glUseProgram(variant.program);
+		glUniform1i(tex, 0);
+		glUseProgram(0);
+	}
+	variant.to_light = glGetUniformLocation(variant.program, "to_light");
+
+	return variant;
+}
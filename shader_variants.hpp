@@ -0,0 +1,53 @@
+#pragma once
+
+#include "GL.hpp"
+#include <string>
+#include <vector>
+
+//"ShaderVariants" builds specialized versions of one vertex + fragment shader pair:
+// each feature bit in a key adds a #define to both sources, so the shaders can
+// #ifdef whole code paths in or out (instead of branching at runtime).
+// Variants are compiled (through the program binary cache) on first use, then reused.
+struct ShaderVariants {
+	enum Feature : uint32_t {
+		UniformScale = 0x1, //UNIFORM_SCALE: normals via mat3(mv) (no 'itmv' inverse-transpose uniform)
+		VertexColors = 0x2, //VERTEX_COLORS: read the per-vertex Color attribute (otherwise white)
+		Fog = 0x4, //FOG: fade to fog with distance from the camera (needs 'mv')
+		Textured = 0x8, //TEXTURED: multiply color by a layer of a GL_TEXTURE_2D_ARRAY ('tex', on unit 0) at TexCoord
+		Instanced = 0x10, //INSTANCED: draw many copies at once; 'mv' (and 'layer') per instance, from the Instances block (see Scene::Instance)
+	};
+	enum { FeatureCount = 5 };
+
+	//attribute locations every variant uses (via layout(location = ...)), so they can share VAOs:
+	enum Location : GLuint {
+		PositionLocation = 0,
+		NormalLocation = 1,
+		ColorLocation = 2,
+		TexCoordLocation = 3,
+	};
+
+	//a compiled variant and its uniform locations (-1U if the variant doesn't use that uniform):
+	// (Instanced variants have 'projection' instead of 'mvp', 'mv', 'itmv', and 'layer'; their Instances
+	//  block is bound to Scene::InstancesBinding, and Textured variants' 'tex' sampler to unit 0)
+	struct Variant {
+		GLuint program = 0;
+		GLuint mvp = -1U;
+		GLuint mv = -1U;
+		GLuint itmv = -1U;
+		GLuint layer = -1U;
+		GLuint projection = -1U;
+		GLuint to_light = -1U;
+	};
+
+	//'vertex_body' and 'fragment_body' are everything after the #version / #define lines:
+	ShaderVariants(std::string const &vertex_body, std::string const &fragment_body);
+
+	//get the variant for a key (bitwise-or of Features), compiling it if needed:
+	// note: will throw if compiling fails.
+	Variant const &get(uint32_t key);
+
+	//internals:
+	std::string vertex_body;
+	std::string fragment_body;
+	std::vector< Variant > variants; //indexed by key; program == 0 if not compiled yet
+};
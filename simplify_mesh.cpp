@@ -0,0 +1,283 @@
+#include "simplify_mesh.hpp"
+
+#include <unordered_map>
+#include <queue>
+#include <cstring>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+namespace {
+
+//symmetric 4x4 matrix, stored as upper triangle:
+struct Quadric {
+	double a[10] = {0,0,0,0,0,0,0,0,0,0};
+	//add w * (plane)(plane)^T for plane (x,y,z,w) with x*px + y*py + z*pz + w = 0:
+	void add_plane(double x, double y, double z, double d, double weight) {
+		a[0] += weight * x * x; a[1] += weight * x * y; a[2] += weight * x * z; a[3] += weight * x * d;
+		a[4] += weight * y * y; a[5] += weight * y * z; a[6] += weight * y * d;
+		a[7] += weight * z * z; a[8] += weight * z * d;
+		a[9] += weight * d * d;
+	}
+	Quadric &operator+=(Quadric const &o) {
+		for (uint32_t i = 0; i < 10; ++i) a[i] += o.a[i];
+		return *this;
+	}
+	//squared distance (sum) from point to the accumulated planes:
+	double error(glm::vec3 const &p) const {
+		double x = p.x, y = p.y, z = p.z;
+		return a[0]*x*x + 2.0*a[1]*x*y + 2.0*a[2]*x*z + 2.0*a[3]*x
+		     + a[4]*y*y + 2.0*a[5]*y*z + 2.0*a[6]*y
+		     + a[7]*z*z + 2.0*a[8]*z
+		     + a[9];
+	}
+	//point minimizing error (returns false if the system is near-singular):
+	bool minimizer(glm::vec3 *out) const {
+		//solve [a0 a1 a2; a1 a4 a5; a2 a5 a7] p = -[a3 a6 a8] by Cramer's rule:
+		double m00 = a[0], m01 = a[1], m02 = a[2];
+		double m11 = a[4], m12 = a[5], m22 = a[7];
+		double b0 = -a[3], b1 = -a[6], b2 = -a[8];
+		double c00 = m11 * m22 - m12 * m12;
+		double c01 = m02 * m12 - m01 * m22;
+		double c02 = m01 * m12 - m02 * m11;
+		double det = m00 * c00 + m01 * c01 + m02 * c02;
+		if (std::abs(det) < 1e-12) return false;
+		double c11 = m00 * m22 - m02 * m02;
+		double c12 = m01 * m02 - m00 * m12;
+		double c22 = m00 * m11 - m01 * m01;
+		out->x = float((c00 * b0 + c01 * b1 + c02 * b2) / det);
+		out->y = float((c01 * b0 + c11 * b1 + c12 * b2) / det);
+		out->z = float((c02 * b0 + c12 * b1 + c22 * b2) / det);
+		return true;
+	}
+};
+
+struct Vertex {
+	glm::vec3 position;
+	Quadric quadric;
+	std::vector< uint32_t > tris; //may include dead triangles
+	uint32_t version = 0;
+	bool alive = true;
+};
+
+struct Tri {
+	uint32_t v[3];
+	bool alive = true;
+	bool has(uint32_t vertex) const { return v[0] == vertex || v[1] == vertex || v[2] == vertex; }
+};
+
+struct Collapse {
+	double cost;
+	uint32_t keep, remove;
+	uint32_t keep_version, remove_version;
+	glm::vec3 position;
+	bool operator<(Collapse const &o) const { return cost > o.cost; } //(min-heap)
+};
+
+struct PositionKey {
+	uint32_t bits[3];
+	bool operator==(PositionKey const &o) const { return std::memcmp(bits, o.bits, sizeof(bits)) == 0; }
+};
+struct PositionHash {
+	size_t operator()(PositionKey const &k) const {
+		return size_t(k.bits[0] * 73856093U ^ k.bits[1] * 19349663U ^ k.bits[2] * 83492791U);
+	}
+};
+
+glm::vec3 tri_normal(glm::vec3 const &a, glm::vec3 const &b, glm::vec3 const &c) {
+	return glm::cross(b - a, c - a);
+}
+
+} //namespace
+
+std::vector< SimplifiedLevel > simplify_mesh(std::vector< glm::vec3 > const &corners, std::vector< uint32_t > const &targets) {
+	assert(corners.size() % 3 == 0);
+
+	std::vector< Vertex > vertices;
+	std::vector< Tri > tris(corners.size() / 3);
+
+	{ //weld corners into vertices:
+		std::unordered_map< PositionKey, uint32_t, PositionHash > welded;
+		for (uint32_t c = 0; c < corners.size(); ++c) {
+			PositionKey key;
+			std::memcpy(key.bits, &corners[c], sizeof(key.bits));
+			auto f = welded.insert(std::make_pair(key, uint32_t(vertices.size())));
+			if (f.second) {
+				vertices.emplace_back();
+				vertices.back().position = corners[c];
+			}
+			tris[c / 3].v[c % 3] = f.first->second;
+		}
+	}
+
+	uint32_t live = 0;
+	{ //drop degenerate triangles, accumulate face quadrics and adjacency:
+		std::unordered_map< uint64_t, uint32_t > edge_uses;
+		auto edge_key = [](uint32_t a, uint32_t b) {
+			return (uint64_t(std::min(a, b)) << 32) | uint64_t(std::max(a, b));
+		};
+		for (uint32_t t = 0; t < tris.size(); ++t) {
+			Tri &tri = tris[t];
+			glm::vec3 n = tri_normal(vertices[tri.v[0]].position, vertices[tri.v[1]].position, vertices[tri.v[2]].position);
+			float area2 = glm::length(n);
+			if (tri.v[0] == tri.v[1] || tri.v[1] == tri.v[2] || tri.v[2] == tri.v[0] || !(area2 > 0.0f)) {
+				tri.alive = false;
+				continue;
+			}
+			n = n / area2;
+			double d = -double(glm::dot(n, vertices[tri.v[0]].position));
+			for (uint32_t i = 0; i < 3; ++i) {
+				//(area-weighted, so big faces resist change more than slivers)
+				vertices[tri.v[i]].quadric.add_plane(n.x, n.y, n.z, d, 0.5 * area2);
+				vertices[tri.v[i]].tris.emplace_back(t);
+				edge_uses[edge_key(tri.v[i], tri.v[(i+1)%3])] += 1;
+			}
+			live += 1;
+		}
+
+		//boundary edges get a steep plane perpendicular to their face, so open borders don't shrink:
+		for (auto const &tri : tris) {
+			if (!tri.alive) continue;
+			glm::vec3 const &a = vertices[tri.v[0]].position;
+			glm::vec3 n = glm::normalize(tri_normal(a, vertices[tri.v[1]].position, vertices[tri.v[2]].position));
+			for (uint32_t i = 0; i < 3; ++i) {
+				uint32_t v0 = tri.v[i], v1 = tri.v[(i+1)%3];
+				if (edge_uses[edge_key(v0, v1)] != 1) continue;
+				glm::vec3 along = vertices[v1].position - vertices[v0].position;
+				float length = glm::length(along);
+				if (!(length > 0.0f)) continue;
+				glm::vec3 perp = glm::normalize(glm::cross(along, n));
+				double d = -double(glm::dot(perp, vertices[v0].position));
+				vertices[v0].quadric.add_plane(perp.x, perp.y, perp.z, d, 1000.0 * length * length);
+				vertices[v1].quadric.add_plane(perp.x, perp.y, perp.z, d, 1000.0 * length * length);
+			}
+		}
+	}
+
+	std::priority_queue< Collapse > heap;
+	auto push_edge = [&](uint32_t keep, uint32_t remove) {
+		Vertex const &k = vertices[keep];
+		Vertex const &r = vertices[remove];
+		Quadric q = k.quadric;
+		q += r.quadric;
+		Collapse c;
+		c.keep = keep;
+		c.remove = remove;
+		c.keep_version = k.version;
+		c.remove_version = r.version;
+		c.position = k.position;
+		c.cost = q.error(k.position);
+		glm::vec3 candidates[3] = { r.position, 0.5f * (k.position + r.position), glm::vec3(0.0f) };
+		uint32_t candidate_count = (q.minimizer(&candidates[2]) ? 3 : 2);
+		for (uint32_t i = 0; i < candidate_count; ++i) {
+			double cost = q.error(candidates[i]);
+			if (cost < c.cost) {
+				c.cost = cost;
+				c.position = candidates[i];
+			}
+		}
+		heap.push(c);
+	};
+	for (auto const &tri : tris) {
+		if (!tri.alive) continue;
+		for (uint32_t i = 0; i < 3; ++i) {
+			if (tri.v[i] < tri.v[(i+1)%3]) push_edge(tri.v[i], tri.v[(i+1)%3]);
+		}
+	}
+
+	//would moving 'moved' to 'position' flip (or collapse) any of its triangles that don't contain 'other'?
+	auto flips = [&](uint32_t moved, uint32_t other, glm::vec3 const &position) {
+		for (uint32_t t : vertices[moved].tris) {
+			Tri const &tri = tris[t];
+			if (!tri.alive || tri.has(other)) continue;
+			glm::vec3 before[3], after[3];
+			for (uint32_t i = 0; i < 3; ++i) {
+				before[i] = after[i] = vertices[tri.v[i]].position;
+				if (tri.v[i] == moved) after[i] = position;
+			}
+			glm::vec3 n0 = tri_normal(before[0], before[1], before[2]);
+			glm::vec3 n1 = tri_normal(after[0], after[1], after[2]);
+			if (glm::dot(n0, n1) <= 0.2f * glm::length(n0) * glm::length(n1)) return true;
+		}
+		return false;
+	};
+
+	std::vector< SimplifiedLevel > levels;
+	auto snapshot = [&]() {
+		levels.emplace_back();
+		SimplifiedLevel &level = levels.back();
+		level.corners.reserve(3 * live);
+		level.positions.reserve(3 * live);
+		for (uint32_t t = 0; t < tris.size(); ++t) {
+			if (!tris[t].alive) continue;
+			for (uint32_t i = 0; i < 3; ++i) {
+				level.corners.emplace_back(3 * t + i);
+				level.positions.emplace_back(vertices[tris[t].v[i]].position);
+			}
+		}
+	};
+
+	std::vector< uint32_t > neighbors;
+	for (uint32_t target : targets) {
+		while (live > target && !heap.empty()) {
+			Collapse c = heap.top();
+			heap.pop();
+			Vertex &keep = vertices[c.keep];
+			Vertex &remove = vertices[c.remove];
+			if (!keep.alive || !remove.alive) continue;
+			if (keep.version != c.keep_version || remove.version != c.remove_version) continue;
+			if (flips(c.keep, c.remove, c.position) || flips(c.remove, c.keep, c.position)) continue;
+
+			//collapse 'remove' into 'keep':
+			keep.position = c.position;
+			keep.quadric += remove.quadric;
+			keep.version += 1;
+			remove.alive = false;
+			for (uint32_t t : remove.tris) {
+				Tri &tri = tris[t];
+				if (!tri.alive) continue;
+				if (tri.has(c.keep)) {
+					tri.alive = false;
+					live -= 1;
+				} else {
+					for (uint32_t i = 0; i < 3; ++i) {
+						if (tri.v[i] == c.remove) tri.v[i] = c.keep;
+					}
+					keep.tris.emplace_back(t);
+				}
+			}
+			remove.tris.clear();
+
+			//compact keep's triangle list and re-queue its edges with updated costs:
+			neighbors.clear();
+			uint32_t out = 0;
+			for (uint32_t t : keep.tris) {
+				if (!tris[t].alive) continue;
+				keep.tris[out++] = t;
+				for (uint32_t i = 0; i < 3; ++i) {
+					uint32_t v = tris[t].v[i];
+					if (v == c.keep) continue;
+					vertices[v].version += 1; //(edges touching v may have changed cost)
+					neighbors.emplace_back(v);
+				}
+			}
+			keep.tris.resize(out);
+			std::sort(neighbors.begin(), neighbors.end());
+			neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+			for (uint32_t v : neighbors) {
+				push_edge(c.keep, v);
+				//re-queue v's other edges, since bumping its version invalidated them:
+				for (uint32_t t : vertices[v].tris) {
+					Tri const &tri = tris[t];
+					if (!tri.alive || tri.has(c.keep)) continue;
+					for (uint32_t i = 0; i < 3; ++i) {
+						if (tri.v[i] != v) push_edge(v, tri.v[i]);
+					}
+				}
+			}
+		}
+		snapshot();
+	}
+
+	return levels;
+}
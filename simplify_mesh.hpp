@@ -0,0 +1,26 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+//Quadric-error-metric mesh simplification (after Garland & Heckbert, "Surface
+// Simplification Using Quadric Error Metrics", 1997), used by pack_assets to
+// build levels of detail.
+
+//one simplified version of a mesh:
+struct SimplifiedLevel {
+	//three entries per triangle, each an index into the input corners
+	// (so per-corner attributes like normals and colors can be carried over):
+	std::vector< uint32_t > corners;
+	//(possibly moved) position for each entry of 'corners':
+	std::vector< glm::vec3 > positions;
+};
+
+//simplify a triangle list (three corners per triangle; corners at identical
+// positions are treated as one vertex) by collapsing edges until each of the
+// (decreasing) triangle counts in 'targets' is reached:
+// note: a level may keep more triangles than its target if no further
+//  collapse is possible without flipping triangles.
+std::vector< SimplifiedLevel > simplify_mesh(std::vector< glm::vec3 > const &corners, std::vector< uint32_t > const &targets);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+//Fixed-capacity single-producer / single-consumer queue (a ring buffer):
+// one thread may push() while another pop()s; neither call ever locks or blocks.
+// (used to hand loaded assets from the loader thread to the GL thread)
+template< typename T >
+struct SPSCQueue {
+	explicit SPSCQueue(size_t capacity) : items(capacity + 1) { }
+
+	//producer: move 'item' into the queue; returns false (leaving 'item' alone) if full:
+	bool push(T &&item) {
+		size_t at = tail.load(std::memory_order_relaxed);
+		size_t next = (at + 1) % items.size();
+		if (next == head.load(std::memory_order_acquire)) return false;
+		items[at] = std::move(item);
+		tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	//consumer: move the oldest item into '*item'; returns false if empty:
+	bool pop(T *item) {
+		size_t at = head.load(std::memory_order_relaxed);
+		if (at == tail.load(std::memory_order_acquire)) return false;
+		*item = std::move(items[at]);
+		items[at] = T(); //(release the item's memory now rather than when the slot is reused)
+		head.store((at + 1) % items.size(), std::memory_order_release);
+		return true;
+	}
+
+	//producer: is there no room to push? (exact for the producer; pops only ever make room)
+	bool full() const {
+		return (tail.load(std::memory_order_relaxed) + 1) % items.size() == head.load(std::memory_order_acquire);
+	}
+
+	//(only a hint while the other thread is active)
+	bool empty() const {
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+
+	std::vector< T > items; //one slot is always left empty, to tell full from empty
+	std::atomic< size_t > head{0}; //next slot to pop (written by consumer)
+	std::atomic< size_t > tail{0}; //next slot to push (written by producer)
+};
@@ -0,0 +1,42 @@
+#include "timeline.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <iomanip>
+#include <algorithm>
+
+namespace {
+	struct Mark {
+		float ms;
+		std::string what;
+		bool main_thread;
+	};
+	//(initialized during static initialization, so 'start' is about when the process launched)
+	std::chrono::high_resolution_clock::time_point const start = std::chrono::high_resolution_clock::now();
+	std::thread::id const main_thread = std::this_thread::get_id();
+	std::mutex mutex;
+	std::vector< Mark > marks;
+}
+
+void timeline_mark(std::string const &what) {
+	float ms = std::chrono::duration< float, std::milli >(std::chrono::high_resolution_clock::now() - start).count();
+	std::lock_guard< std::mutex > lock(mutex);
+	marks.emplace_back(Mark{ms, what, std::this_thread::get_id() == main_thread});
+}
+
+void timeline_report(std::ostream &out) {
+	std::vector< Mark > sorted;
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		sorted = marks;
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](Mark const &a, Mark const &b) { return a.ms < b.ms; });
+	out << "Startup timeline (ms since launch; background threads indented):\n";
+	for (auto const &mark : sorted) {
+		out << std::setw(9) << std::fixed << std::setprecision(1) << mark.ms
+		    << (mark.main_thread ? "  " : "      ") << mark.what << '\n';
+	}
+	out.flush();
+}
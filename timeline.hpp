@@ -0,0 +1,13 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+
+//Startup timeline: threads call timeline_mark() as they reach milestones;
+// timeline_report() prints them all in order, in ms since the process started.
+
+//record that 'what' just happened (safe to call from any thread):
+void timeline_mark(std::string const &what);
+
+//print every mark so far (marks from threads other than the main one are indented):
+void timeline_report(std::ostream &out);